@@ -10,6 +10,8 @@ UUID 0xFCD2 sponsored by Allterco Robotics (Shelly)
 Supports ESP32 (ESP-IDF) and nRF52 (Zephyr) platforms.
 """
 
+import logging
+
 import esphome.codegen as cg
 from esphome.components import binary_sensor, sensor
 import esphome.config_validation as cv
@@ -23,6 +25,8 @@ from esphome.const import (
 from esphome.core import CORE, TimePeriod
 from esphome import automation
 
+_LOGGER = logging.getLogger(__name__)
+
 CODEOWNERS = ["@esphome/core"]
 
 # Dependencies ensure USE_SENSOR and USE_BINARY_SENSOR are defined
@@ -30,7 +34,7 @@ CODEOWNERS = ["@esphome/core"]
 DEPENDENCIES = []
 
 # Auto-load these components when bthome is used
-AUTO_LOAD = []
+AUTO_LOAD = ["bthome_codec"]
 
 # BLE stack options for ESP32
 CONF_BLE_STACK = "ble_stack"
@@ -46,6 +50,7 @@ DimEventAction = bthome_ns.class_("DimEventAction", automation.Action)
 
 # Configuration constants
 CONF_ENCRYPTION_KEY = "encryption_key"
+CONF_COUNTER_RESERVATION = "counter_reservation"
 CONF_MIN_INTERVAL = "min_interval"
 CONF_MAX_INTERVAL = "max_interval"
 CONF_ADVERTISE_IMMEDIATELY = "advertise_immediately"
@@ -56,6 +61,11 @@ CONF_INDEX = "index"
 CONF_ACTION = "action"
 CONF_STEPS = "steps"
 CONF_MAX_EVENTS = "max_events"
+CONF_EVENT_QUEUE_SIZE = "event_queue_size"
+CONF_ROTATION_INTERVAL = "rotation_interval"
+CONF_MAX_STALENESS = "max_staleness"
+CONF_KEYFRAME_INTERVAL = "keyframe_interval"
+CONF_EXTENDED_ADVERTISING = "extended_advertising"
 
 int8_t = cv.int_range(min=-128, max=127)
 int8 = cg.global_ns.class_("int8_t")
@@ -247,6 +257,20 @@ def button_event_type(value):
 def _final_validate(config):
     if not CORE.is_esp32 and not CORE.is_nrf52:
         raise cv.Invalid("BTHome only supports ESP32 and nRF52 platforms")
+    if config[CONF_EXTENDED_ADVERTISING] and CORE.is_esp32:
+        from esphome.components.esp32 import get_esp32_variant
+        from esphome.components.esp32.const import VARIANT_ESP32
+
+        if config[CONF_BLE_STACK] != BLE_STACK_NIMBLE:
+            raise cv.Invalid("extended_advertising requires ble_stack: nimble")
+        if get_esp32_variant() == VARIANT_ESP32:
+            raise cv.Invalid("extended_advertising requires a Bluetooth 5 chip such as the ESP32-C3 or ESP32-S3")
+    if config[CONF_EXTENDED_ADVERTISING]:
+        _LOGGER.warning(
+            "extended_advertising: advertisements longer than 31 bytes are only seen by Bluetooth 5 "
+            "scanners that scan for extended advertisements. The bthome_receiver component and many "
+            "Bluetooth proxies only receive legacy advertisements and will miss them."
+        )
     return config
 
 
@@ -268,18 +292,36 @@ CONFIG_SCHEMA = cv.All(
             ),
             cv.Optional(CONF_TX_POWER, default=0): validate_tx_power,
             cv.Optional(CONF_ENCRYPTION_KEY): validate_encryption_key,
+            # Encryption counter persisted every N packets (0 = restart from 0 at boot)
+            cv.Optional(CONF_COUNTER_RESERVATION, default=1024): cv.int_range(min=0, max=1000000),
             cv.Optional(CONF_RETRANSMIT_COUNT, default=0): cv.int_range(min=0, max=10),
             cv.Optional(CONF_RETRANSMIT_INTERVAL, default="500ms"): cv.All(
                 cv.positive_time_period_milliseconds,
                 cv.Range(min=TimePeriod(milliseconds=100), max=TimePeriod(milliseconds=2000)),
             ),
             cv.Optional(CONF_MAX_EVENTS, default=0): cv.int_range(min=0, max=16),
+            # Event advertisements buffered while an earlier one is still being sent
+            cv.Optional(CONF_EVENT_QUEUE_SIZE, default=4): cv.int_range(min=1, max=32),
+            # How long each frame stays on air when the measurements need several advertisements
+            cv.Optional(CONF_ROTATION_INTERVAL, default="5s"): cv.All(
+                cv.positive_time_period_milliseconds,
+                cv.Range(min=TimePeriod(seconds=1), max=TimePeriod(hours=1)),
+            ),
+            # BLE 5 extended advertising: up to 244 bytes, so all measurements fit in one advertisement
+            cv.Optional(CONF_EXTENDED_ADVERTISING, default=False): cv.boolean,
+            # Change-only mode: unchanged values are left out, with a full snapshot this often
+            cv.Optional(CONF_KEYFRAME_INTERVAL): cv.All(
+                cv.positive_time_period_milliseconds,
+                cv.Range(min=TimePeriod(seconds=10), max=TimePeriod(hours=24)),
+            ),
             cv.Optional(CONF_SENSORS): cv.ensure_list(
                 cv.Schema(
                     {
                         cv.Required(CONF_TYPE): cv.one_of(*SENSOR_TYPES.keys(), lower=True),
                         cv.Required(CONF_ID): cv.use_id(sensor.Sensor),
                         cv.Optional(CONF_ADVERTISE_IMMEDIATELY, default=False): cv.boolean,
+                        # Longest time between two advertisements of this value in the rotation
+                        cv.Optional(CONF_MAX_STALENESS): cv.positive_time_period_milliseconds,
                     }
                 )
             ),
@@ -289,6 +331,8 @@ CONFIG_SCHEMA = cv.All(
                         cv.Required(CONF_TYPE): cv.one_of(*BINARY_SENSOR_TYPES.keys(), lower=True),
                         cv.Required(CONF_ID): cv.use_id(binary_sensor.BinarySensor),
                         cv.Optional(CONF_ADVERTISE_IMMEDIATELY, default=False): cv.boolean,
+                        # Longest time between two advertisements of this value in the rotation
+                        cv.Optional(CONF_MAX_STALENESS): cv.positive_time_period_milliseconds,
                     }
                 )
             ),
@@ -312,6 +356,7 @@ async def to_code(config):
     cg.add_define("BTHOME_MAX_BINARY_MEASUREMENTS", num_binary_sensors)
     cg.add_define("BTHOME_MAX_ADV_PACKETS", max_packets)
     cg.add_define("BTHOME_MAX_EVENTS", max_events)
+    cg.add_define("BTHOME_EVENT_QUEUE_SIZE", config[CONF_EVENT_QUEUE_SIZE])
 
     # Define BTHOME_USE_EVENTS if max_events is above zero
     if max_events > 0:
@@ -325,6 +370,9 @@ async def to_code(config):
     cg.add(var.set_tx_power(config[CONF_TX_POWER]))
     cg.add(var.set_retransmit_count(config[CONF_RETRANSMIT_COUNT]))
     cg.add(var.set_retransmit_interval(config[CONF_RETRANSMIT_INTERVAL]))
+    cg.add(var.set_rotation_interval(config[CONF_ROTATION_INTERVAL]))
+    if CONF_KEYFRAME_INTERVAL in config:
+        cg.add(var.set_keyframe_interval(config[CONF_KEYFRAME_INTERVAL]))
 
     # Always use ESPHome device name
     if CORE.name:
@@ -338,6 +386,7 @@ async def to_code(config):
         key_bytes = [cg.RawExpression(f"0x{key[i:i + 2]}") for i in range(0, len(key), 2)]
         key_array = cg.RawExpression(f"std::array<uint8_t, 16>{{{', '.join(str(b) for b in key_bytes)}}}")
         cg.add(var.set_encryption_key(key_array))
+        cg.add(var.set_counter_reservation(config[CONF_COUNTER_RESERVATION]))
 
     # Add sensor measurements
     if CONF_SENSORS in config:
@@ -350,7 +399,12 @@ async def to_code(config):
             factor = type_info[3]
             sens = await cg.get_variable(measurement[CONF_ID])
             advertise_immediately = measurement[CONF_ADVERTISE_IMMEDIATELY]
-            cg.add(var.add_measurement(sens, object_id, data_bytes, is_signed, factor, advertise_immediately))
+            max_staleness = measurement.get(CONF_MAX_STALENESS, 0)
+            cg.add(
+                var.add_measurement(
+                    sens, object_id, data_bytes, is_signed, factor, advertise_immediately, max_staleness
+                )
+            )
 
     # Add binary sensor measurements
     if CONF_BINARY_SENSORS in config:
@@ -359,7 +413,11 @@ async def to_code(config):
             object_id = BINARY_SENSOR_TYPES[sensor_type]
             sens = await cg.get_variable(measurement[CONF_ID])
             advertise_immediately = measurement[CONF_ADVERTISE_IMMEDIATELY]
-            cg.add(var.add_binary_measurement(sens, object_id, advertise_immediately))
+            max_staleness = measurement.get(CONF_MAX_STALENESS, 0)
+            cg.add(var.add_binary_measurement(sens, object_id, advertise_immediately, max_staleness))
+
+    if config[CONF_EXTENDED_ADVERTISING]:
+        cg.add_define("USE_BTHOME_EXTENDED_ADV")
 
     # Platform-specific setup
     if CORE.is_esp32:
@@ -382,6 +440,9 @@ async def to_code(config):
             add_idf_sdkconfig_option("CONFIG_BT_NIMBLE_ROLE_BROADCASTER", True)
             # Enable use of raw adv data
             add_idf_sdkconfig_option("CONFIG_BT_NIMBLE_EXT_ADV", True)
+            if config[CONF_EXTENDED_ADVERTISING]:
+                # Room for a whole extended advertisement in one HCI command
+                add_idf_sdkconfig_option("CONFIG_BT_NIMBLE_EXT_ADV_MAX_SIZE", 251)
             # Use tinycrypt for smaller footprint (saves ~7KB)
             add_idf_sdkconfig_option("CONFIG_BT_NIMBLE_CRYPTO_STACK_MBEDTLS", False)
         else:
@@ -400,6 +461,10 @@ async def to_code(config):
         zephyr_add_prj_conf("BT", True)
         zephyr_add_prj_conf("BT_BROADCASTER", True)
         zephyr_add_prj_conf("BT_DEVICE_NAME", f'"{CORE.name}"')
+        if config[CONF_EXTENDED_ADVERTISING]:
+            zephyr_add_prj_conf("BT_EXT_ADV", True)
+            zephyr_add_prj_conf("BT_CTLR_ADV_EXT", True)
+            zephyr_add_prj_conf("BT_CTLR_ADV_DATA_LEN_MAX", 251)
 
         # Enable tinycrypt for AES-CCM encryption
         zephyr_add_prj_conf("TINYCRYPT", True)
@@ -1,9 +1,11 @@
 #include "bthome.h"
+#include "esphome/core/hal.h"
 #include "esphome/core/log.h"
 #include "esphome/core/version.h"
 
 #if defined(USE_ESP32) || defined(USE_NRF52)
 
+#include <algorithm>
 #include <cstring>
 #include <cmath>
 
@@ -81,6 +83,44 @@ void BTHome::dump_config() {
 #ifdef USE_BINARY_SENSOR
   ESP_LOGCONFIG(TAG, "  Binary Sensors: %d", this->binary_measurements_.size());
 #endif
+  if (this->immediate_latency_count_ > 0) {
+    ESP_LOGCONFIG(TAG, "  Immediate Latency: avg %ums, max %ums over %u values", this->get_immediate_latency_avg_ms(),
+                  this->immediate_latency_max_ms_, this->immediate_latency_count_);
+  }
+#ifdef BTHOME_USE_EVENTS
+  ESP_LOGCONFIG(TAG, "  Event Queue: %u frames, %u merged, %u dropped", BTHOME_EVENT_QUEUE_SIZE,
+                this->events_merged_, this->events_dropped_);
+#endif
+#ifdef USE_BTHOME_EXTENDED_ADV
+  ESP_LOGCONFIG(TAG, "  Extended Advertising: %s (%u bytes)", this->extended_active_ ? "yes" : "legacy fallback",
+                (unsigned) this->max_adv_size_());
+#endif
+  const size_t frame_count = this->schedule_starts_.size() - 1;
+  if (frame_count > 1) {
+    // Worst case: a value changing just after its frame left the air waits for its next frame
+    ESP_LOGCONFIG(TAG, "  Rotation: %u frames, %ums each", (unsigned) frame_count, this->rotation_interval_);
+#ifdef USE_SENSOR
+    for (size_t i = 0; i < this->measurements_.size(); i++) {
+      const auto &measurement = this->measurements_[i];
+      ESP_LOGCONFIG(TAG, "    %s: refreshed every %ums or less", measurement.sensor->get_name().c_str(),
+                    (uint32_t) (this->max_frame_gap_(i) * this->rotation_interval_));
+    }
+#endif
+#ifdef USE_BINARY_SENSOR
+    for (size_t i = 0; i < this->binary_measurements_.size(); i++) {
+      const auto &measurement = this->binary_measurements_[i];
+      ESP_LOGCONFIG(TAG, "    %s: refreshed every %ums or less", measurement.sensor->get_name().c_str(),
+                    (uint32_t) (this->max_frame_gap_(i | SCHEDULE_BINARY) * this->rotation_interval_));
+    }
+#endif
+  }
+  if (this->keyframe_interval_ > 0) {
+    ESP_LOGCONFIG(TAG, "  Change-only: keyframe every %ums", this->keyframe_interval_);
+  }
+  if (this->encryption_enabled_) {
+    ESP_LOGCONFIG(TAG, "  Counter: %u, Reservation: %u, Flash Writes: %u", this->counter_,
+                  this->counter_reservation_, this->counter_flash_writes_);
+  }
 }
 
 float BTHome::get_setup_priority() const {
@@ -94,6 +134,24 @@ float BTHome::get_setup_priority() const {
 void BTHome::setup() {
   ESP_LOGD(TAG, "Setting up BTHome...");
 
+  if (this->encryption_enabled_ && this->counter_reservation_ > 0) {
+    this->load_counter_();
+  }
+
+  this->build_schedule_();
+
+  if (this->keyframe_interval_ > 0) {
+    // Boot starts with a keyframe so receivers learn every value
+    this->keyframe_start_ = millis();
+    this->set_interval("keyframe", this->keyframe_interval_, [this]() {
+      this->keyframe_start_ = millis();
+      this->data_changed_ = true;
+#ifdef USE_ESP32
+      this->enable_loop();
+#endif
+    });
+  }
+
 #ifdef USE_ESP32
   #ifdef USE_BTHOME_NIMBLE
   // NimBLE stack initialization
@@ -225,6 +283,25 @@ void BTHome::setup() {
 void BTHome::loop() {
   uint32_t now = esp_timer_get_time() / 1000;  // Convert microseconds to milliseconds
 
+#ifdef USE_BTHOME_EXTENDED_ADV
+  // Repack for 31-byte advertisements and restart in legacy mode
+  if (this->legacy_fallback_pending_) {
+    this->legacy_fallback_pending_ = false;
+    this->build_schedule_();
+    this->build_advertisement_data_();
+    this->build_scan_response_data_();
+    this->start_advertising_();
+  }
+#endif
+
+  if (this->counter_reservation_pending_) {
+    this->counter_reservation_pending_ = false;
+    this->reserve_counters_();
+    if (this->retransmit_remaining_ == 0 && !this->data_changed_) {
+      this->disable_loop_if_idle_();
+    }
+  }
+
   // Handle retransmissions
   if (this->retransmit_remaining_ > 0 && this->advertising_) {
     if (now - this->last_retransmit_time_ >= this->retransmit_interval_) {
@@ -236,12 +313,10 @@ void BTHome::loop() {
       this->stop_advertising_();
       this->start_advertising_();
 
-#ifdef USE_ESP32
       // Keep loop enabled while retransmissions pending
       if (this->retransmit_remaining_ == 0) {
-        this->disable_loop();
+        this->disable_loop_if_idle_();
       }
-#endif
     }
     return;
   }
@@ -249,9 +324,14 @@ void BTHome::loop() {
   // Handle immediate advertising requests (sensors or events)
   if (this->immediate_advertising_pending_
 #ifdef BTHOME_USE_EVENTS
-      || this->immediate_event_count_ > 0
+      || this->has_pending_events_()
 #endif
   ) {
+    // Leave the previous immediate frame on air for a retransmit interval before replacing it
+    if (now - this->last_immediate_frame_time_ < this->retransmit_interval_) {
+      return;
+    }
+    this->last_immediate_frame_time_ = now;
     this->stop_advertising_();
     this->build_advertisement_data_();
     this->start_advertising_();
@@ -262,9 +342,7 @@ void BTHome::loop() {
       this->last_retransmit_time_ = now;
       // Keep loop enabled for retransmissions
     } else {
-#ifdef USE_ESP32
-      this->disable_loop();
-#endif
+      this->disable_loop_if_idle_();
     }
     return;
   }
@@ -282,18 +360,70 @@ void BTHome::loop() {
       this->last_retransmit_time_ = now;
       // Keep loop enabled for retransmissions
     } else {
-#ifdef USE_ESP32
-      this->disable_loop();
-#endif
+      this->disable_loop_if_idle_();
     }
   }
 }
 
+void BTHome::disable_loop_if_idle_() {
+  // Values that spilled out of the last immediate frame
+  if (this->immediate_advertising_pending_) {
+    return;
+  }
+  // The next counter block is saved from loop()
+  if (this->counter_reservation_pending_) {
+    return;
+  }
+#ifdef BTHOME_USE_EVENTS
+  // Queued event frames go out one per loop pass
+  if (this->has_pending_events_()) {
+    return;
+  }
+#endif
+#ifdef USE_ESP32
+  this->disable_loop();
+#endif
+}
+
 void BTHome::set_encryption_key(const std::array<uint8_t, 16> &key) {
   this->encryption_enabled_ = true;
   this->encryption_key_ = key;
 }
 
+void BTHome::load_counter_() {
+  this->counter_pref_ = global_preferences->make_preference<uint32_t>(fnv1_hash("bthome_counter"), true);
+
+  // Every counter below the saved reservation may have been used before the reboot: skip them all
+  uint32_t reserved;
+  if (this->counter_pref_.load(&reserved)) {
+    this->counter_ = reserved;
+    ESP_LOGD(TAG, "Resuming encryption counter at %u", reserved);
+  }
+  this->reserve_counters_();
+}
+
+void BTHome::request_counter_reservation_() {
+  // Advertisements are also built on the NimBLE host task, which must not wait for a flash
+  // write: the reservation is saved from loop()
+  this->counter_reservation_pending_ = true;
+#ifdef USE_ESP32
+  this->enable_loop_soon_any_context();
+#endif
+}
+
+void BTHome::reserve_counters_() {
+  // Persist before any counter of the new block is used, so a reset can never reuse a nonce.
+  // Reserved ahead, the new block starts where the current one ends.
+  uint32_t reserved = std::max(this->counter_, this->counter_reserved_until_) + this->counter_reservation_;
+  this->counter_reserved_until_ = reserved;
+  if (!this->counter_pref_.save(&reserved) || !global_preferences->sync()) {
+    ESP_LOGW(TAG, "Failed to persist encryption counter reservation");
+    return;
+  }
+  this->counter_flash_writes_++;
+  ESP_LOGD(TAG, "Reserved encryption counters up to %u (%u flash writes)", reserved, this->counter_flash_writes_);
+}
+
 void BTHome::set_device_name(const std::string &name) {
   if (name.length() > MAX_DEVICE_NAME_LENGTH) {
     this->device_name_ = name.substr(0, MAX_DEVICE_NAME_LENGTH);
@@ -305,14 +435,17 @@ void BTHome::set_device_name(const std::string &name) {
 
 #ifdef USE_SENSOR
 void BTHome::add_measurement(sensor::Sensor *sensor, uint8_t object_id, uint8_t data_bytes,
-                              bool is_signed, float factor, bool advertise_immediately) {
-  this->measurements_.push_back({sensor, object_id, data_bytes, is_signed, factor, advertise_immediately});
+                              bool is_signed, float factor, bool advertise_immediately, uint32_t max_staleness) {
+  this->measurements_.push_back(
+      {sensor, object_id, data_bytes, is_signed, factor, advertise_immediately, max_staleness, 0, 0, false});
 }
 #endif
 
 #ifdef USE_BINARY_SENSOR
-void BTHome::add_binary_measurement(binary_sensor::BinarySensor *sensor, uint8_t object_id, bool advertise_immediately) {
-  this->binary_measurements_.push_back({sensor, object_id, advertise_immediately});
+void BTHome::add_binary_measurement(binary_sensor::BinarySensor *sensor, uint8_t object_id, bool advertise_immediately,
+                                    uint32_t max_staleness) {
+  this->binary_measurements_.push_back(
+      {sensor, object_id, advertise_immediately, max_staleness, 0, 0, false});
 }
 #endif
 
@@ -322,9 +455,9 @@ void BTHome::send_events(const BTHomeEvent *events, size_t count) {
     ESP_LOGW(TAG, "No events to send");
     return;
   }
-  
+
   ESP_LOGD(TAG, "Sending %d event(s)", count);
-  
+
   // Use the immediate event advertising mechanism
   this->trigger_immediate_event_advertising_(events, count);
 }
@@ -335,20 +468,20 @@ void BTHome::send_button_event(uint8_t index, uint8_t action) {
     ESP_LOGW(TAG, "Button index %d exceeds max_events (%d)", index, BTHOME_MAX_EVENTS);
     return;
   }
-  
+
   ESP_LOGD(TAG, "Sending button event: index=%d, action=0x%02X", index, action);
-  
+
   // Per BTHome v2 spec: Multiple buttons are represented by multiple sequential 0x3A objects
   // For a single button event at specific index, we need to send (index+1) events,
   // with 0x00 (NONE) for all preceding buttons
   // See: https://bthome.io/format/ - "Multiple events of the same type"
-  
+
   BTHomeEvent events[BTHOME_MAX_EVENTS] = {0};
   for (uint8_t i = 0; i <= index; i++) {
     events[i].object_id = OBJECT_ID_BUTTON;
   }
   events[index].data.event = action;
-  
+
   this->send_events(events, index + 1);
 }
 
@@ -358,18 +491,18 @@ void BTHome::send_dim_event(uint8_t index, int8_t step) {
     ESP_LOGW(TAG, "Dimmer index %d exceeds max_events (%d)", index, BTHOME_MAX_EVENTS);
     return;
   }
-  
+
   ESP_LOGD(TAG, "Sending dimmer event: index=%d, step=%d", index, step);
-  
+
   // For dimmer events, we follow the same pattern as buttons
   // Multiple dimmers are represented by multiple sequential 0x3C objects
-  
+
   BTHomeEvent events[BTHOME_MAX_EVENTS] = {0};
   for (uint8_t i = 0; i <= index; i++) {
     events[i].object_id = OBJECT_ID_DIMMER;
   }
   events[index].data.step = step;
-  
+
   this->send_events(events, index + 1);
 }
 
@@ -378,27 +511,143 @@ void BTHome::trigger_immediate_event_advertising_(const BTHomeEvent *events, siz
     ESP_LOGW(TAG, "Invalid event count for immediate advertising");
     return;
   }
-  
-  // Store event data for use in build_advertisement_data_
-  memcpy(this->immediate_event_data_, events, count * sizeof(BTHomeEvent));
-  this->immediate_event_count_ = count;
-  
+
+  // Presses arriving before the previous frame went out share its advertisement when they can
+  if (this->event_queue_count_ > 0) {
+    size_t tail = (this->event_queue_head_ + this->event_queue_count_ - 1) % BTHOME_EVENT_QUEUE_SIZE;
+    if (this->merge_events_(this->event_queue_[tail], events, count)) {
+      this->events_merged_++;
+      ESP_LOGD(TAG, "Merged %u event(s) into queued frame", (unsigned) count);
+      return;
+    }
+  }
+
+  if (this->event_queue_count_ == BTHOME_EVENT_QUEUE_SIZE) {
+    // Drop the oldest frame so the most recent input is not lost
+    this->event_queue_head_ = (this->event_queue_head_ + 1) % BTHOME_EVENT_QUEUE_SIZE;
+    this->event_queue_count_--;
+    this->events_dropped_++;
+    ESP_LOGW(TAG, "Event queue full, dropped oldest frame (%u dropped in total)", this->events_dropped_);
+  }
+
+  EventFrame &frame =
+      this->event_queue_[(this->event_queue_head_ + this->event_queue_count_) % BTHOME_EVENT_QUEUE_SIZE];
+  memcpy(frame.events, events, count * sizeof(BTHomeEvent));
+  frame.count = count;
+  // BTHome expects ascending object IDs; a stable sort keeps the button/dimmer order within a type
+  std::stable_sort(frame.events, frame.events + count, [](const BTHomeEvent &a, const BTHomeEvent &b) {
+    return a.object_id < b.object_id;
+  });
+  this->event_queue_count_++;
+
 #ifdef USE_ESP32
   this->enable_loop();
 #endif
 }
+
+bool BTHome::merge_events_(EventFrame &frame, const BTHomeEvent *events, size_t count) const {
+  // The n-th object of a type addresses button/dimmer n, so objects are matched by occurrence.
+  // A button can carry one event per advertisement; dimmer steps add up.
+  EventFrame merged = frame;
+  for (size_t i = 0; i < count; i++) {
+    const BTHomeEvent &event = events[i];
+    size_t occurrence = 0;
+    for (size_t j = 0; j < i; j++) {
+      if (events[j].object_id == event.object_id) {
+        occurrence++;
+      }
+    }
+
+    // Find the same button/dimmer in the frame, or where to insert it: after its type's objects,
+    // or before the first object with a higher ID, keeping the object IDs in ascending order
+    size_t found = merged.count;
+    size_t insert = merged.count;
+    size_t seen = 0;
+    for (size_t j = 0; j < merged.count; j++) {
+      if (merged.events[j].object_id > event.object_id) {
+        if (seen == 0) {
+          insert = j;
+        }
+        break;
+      }
+      if (merged.events[j].object_id != event.object_id) {
+        continue;
+      }
+      if (seen++ == occurrence) {
+        found = j;
+        break;
+      }
+      insert = j + 1;
+    }
+
+    if (found < merged.count) {
+      BTHomeEvent &existing = merged.events[found];
+      if (event.data.event == BUTTON_EVENT_NONE) {
+        continue;
+      }
+      if (existing.data.event == BUTTON_EVENT_NONE) {
+        existing.data = event.data;
+      } else if (event.object_id == OBJECT_ID_DIMMER) {
+        int step = existing.data.step + event.data.step;
+        if (step < INT8_MIN || step > INT8_MAX) {
+          return false;
+        }
+        existing.data.step = step;
+      } else {
+        return false;
+      }
+      continue;
+    }
+
+    if (merged.count >= BTHOME_MAX_EVENTS) {
+      return false;
+    }
+    memmove(&merged.events[insert + 1], &merged.events[insert], (merged.count - insert) * sizeof(BTHomeEvent));
+    merged.events[insert] = event;
+    merged.count++;
+  }
+
+  // Every event object is 2 bytes and must fit beside the packet ID
+  if (merged.count * 2u > this->payload_capacity_()) {
+    return false;
+  }
+  frame = merged;
+  return true;
+}
 #endif
 
 void BTHome::trigger_immediate_sensor_advertising_(uint8_t measurement_index, bool is_binary) {
+  // Latency is measured from the first change that has not been advertised yet
+  uint32_t now = millis();
+#ifdef USE_BINARY_SENSOR
+  if (is_binary && !this->immediate_binary_dirty_[measurement_index]) {
+    this->immediate_binary_dirty_[measurement_index] = true;
+    this->binary_measurements_[measurement_index].changed_time = now;
+  }
+#endif
+#ifdef USE_SENSOR
+  if (!is_binary && !this->immediate_dirty_[measurement_index]) {
+    this->immediate_dirty_[measurement_index] = true;
+    this->measurements_[measurement_index].changed_time = now;
+  }
+#endif
   this->immediate_advertising_pending_ = true;
-  this->immediate_adv_measurement_index_ = measurement_index;
-  this->immediate_adv_is_binary_ = is_binary;
 #ifdef USE_ESP32
   this->enable_loop();
 #endif
 }
 
 void BTHome::build_advertisement_data_() {
+  // Every counter of the persisted block is used and loop() has not reserved the next one yet:
+  // keep the previous frame on air rather than use a counter a reset could repeat
+  if (this->encryption_enabled_ && this->counter_reservation_ > 0 &&
+      this->counter_ >= this->counter_reserved_until_) {
+    ESP_LOGW(TAG, "Encryption counter block exhausted, waiting for the next reservation");
+    this->data_changed_ = true;
+    this->request_counter_reservation_();
+    return;
+  }
+
   size_t pos = 0;
 
   // Flags AD element
@@ -425,6 +674,8 @@ void BTHome::build_advertisement_data_() {
   this->adv_data_[pos++] = device_info;
 
   size_t measurement_start = pos;
+  // Encrypted payloads need room for the counter and MIC after the ciphertext
+  const size_t payload_end = this->max_adv_size_() - (this->encryption_enabled_ ? ENCRYPTION_OVERHEAD : 0);
 
   // Packet ID (object 0x00) - helps receivers deduplicate retransmissions
   // Only incremented when build_advertisement_data_() is called (new data)
@@ -433,126 +684,135 @@ void BTHome::build_advertisement_data_() {
   this->adv_data_[pos++] = this->packet_id_;
 
 #ifdef BTHOME_USE_EVENTS
-  // Handle immediate event advertising
-  if (this->immediate_event_count_ > 0) {
-    for (size_t i = 0; i < this->immediate_event_count_; i++) {
-      const BTHomeEvent &event = this->immediate_event_data_[i];
-      size_t event_len = this->encode_event_(this->adv_data_ + pos, MAX_BLE_ADVERTISEMENT_SIZE - pos, 
-                                             event.object_id, reinterpret_cast<const uint8_t*>(&event.data.event), 1);
+  // Handle immediate event advertising: one queued frame per advertisement
+  if (this->event_queue_count_ > 0) {
+    const EventFrame &frame = this->event_queue_[this->event_queue_head_];
+    for (size_t i = 0; i < frame.count; i++) {
+      const BTHomeEvent &event = frame.events[i];
+      size_t event_len = bthome_codec::encode_event(this->adv_data_ + pos, payload_end - pos, event.object_id,
+                                                    reinterpret_cast<const uint8_t *>(&event.data.event), 1);
       if (event_len == 0) {
         ESP_LOGW(TAG, "Not enough space for event %d in advertisement", i);
         break;
       }
       pos += event_len;
     }
-    // Clear event count after encoding
-    this->immediate_event_count_ = 0;
+    this->event_queue_head_ = (this->event_queue_head_ + 1) % BTHOME_EVENT_QUEUE_SIZE;
+    this->event_queue_count_--;
   }
 #endif
-  // Handle immediate sensor advertising - single sensor only
+  // Handle immediate sensor advertising - every dirty value that fits, the rest stays dirty
   if (this->immediate_advertising_pending_) {
+    uint32_t now = millis();
+    bool spilled = false;
 #ifdef USE_BINARY_SENSOR
-    if (this->immediate_adv_is_binary_) {
-      auto &measurement = this->binary_measurements_[this->immediate_adv_measurement_index_];
+    for (size_t i = 0; i < this->binary_measurements_.size(); i++) {
+      if (!this->immediate_binary_dirty_[i]) {
+        continue;
+      }
+      auto &measurement = this->binary_measurements_[i];
       if (measurement.sensor->has_state()) {
-        pos += this->encode_binary_measurement_(this->adv_data_ + pos, MAX_BLE_ADVERTISEMENT_SIZE - pos,
-                                                 measurement.object_id, measurement.sensor->state);
+        size_t len = bthome_codec::encode_binary(this->adv_data_ + pos, payload_end - pos, measurement.object_id,
+                                                 measurement.sensor->state);
+        if (len == 0) {
+          spilled = true;
+          continue;
+        }
+        this->track_raw_(measurement.last_raw, measurement.last_raw_valid, this->adv_data_ + pos, len, true);
+        pos += len;
+        this->record_immediate_latency_(now - measurement.changed_time);
       }
+      this->immediate_binary_dirty_[i] = false;
     }
 #endif
 #ifdef USE_SENSOR
-    if (!this->immediate_adv_is_binary_) {
-      auto &measurement = this->measurements_[this->immediate_adv_measurement_index_];
+    for (size_t i = 0; i < this->measurements_.size(); i++) {
+      if (!this->immediate_dirty_[i]) {
+        continue;
+      }
+      auto &measurement = this->measurements_[i];
       if (measurement.sensor->has_state() && !std::isnan(measurement.sensor->state)) {
-        pos += this->encode_measurement_(this->adv_data_ + pos, MAX_BLE_ADVERTISEMENT_SIZE - pos, measurement);
+        // A smaller value further on may still fit
+        if (pos + 1 + measurement.data_bytes > payload_end) {
+          spilled = true;
+          continue;
+        }
+        size_t len = this->encode_measurement_(this->adv_data_ + pos, payload_end - pos, measurement);
+        this->track_raw_(measurement.last_raw, measurement.last_raw_valid, this->adv_data_ + pos, len, true);
+        pos += len;
+        this->record_immediate_latency_(now - measurement.changed_time);
       }
+      this->immediate_dirty_[i] = false;
     }
 #endif
-    // Clear sensor flag after encoding
-    this->immediate_advertising_pending_ = false;
+    this->immediate_advertising_pending_ = spilled;
+    if (spilled) {
+      ESP_LOGD(TAG, "Immediate values did not fit, spilling into the next frame");
+    }
   } else {
-    // Normal: add measurements with rotation (for splitting across packets)
-#ifdef USE_SENSOR
-    if (!this->measurements_.empty()) {
-      size_t start_idx = this->current_sensor_index_;
-      size_t count = this->measurements_.size();
-      size_t added = 0;
-
-      // Rotate through measurements starting from current index
-      for (size_t i = 0; i < count; i++) {
-        size_t idx = (start_idx + i) % count;
-        const auto &measurement = this->measurements_[idx];
-
-        if (!measurement.sensor->has_state() || std::isnan(measurement.sensor->state))
-          continue;
-
-        // Check if measurement fits: object_id (1 byte) + data_bytes
-        size_t encoded_size = 1 + measurement.data_bytes;
-        if (pos + encoded_size > MAX_BLE_ADVERTISEMENT_SIZE)
-          break;
-
-        pos += this->encode_measurement_(this->adv_data_ + pos, MAX_BLE_ADVERTISEMENT_SIZE - pos, measurement);
-        added++;
-      }
-
-      // Advance index for next advertisement (rotate through all sensors)
-      if (added > 0 && added < count) {
-        this->current_sensor_index_ = (start_idx + added) % count;
+    // Normal: the measurements of the current frame of the rotation schedule. In change-only
+    // mode a keyframe keeps every value in the frames for one rotation cycle.
+    size_t frame = this->current_frame_;
+    size_t frame_count = this->schedule_starts_.size() - 1;
+    bool keyframe = this->keyframe_interval_ == 0 ||
+                    millis() - this->keyframe_start_ < frame_count * this->rotation_interval_;
+    for (size_t i = this->schedule_starts_[frame]; i < this->schedule_starts_[frame + 1]; i++) {
+      uint16_t id = this->schedule_items_[i];
+#ifdef USE_BINARY_SENSOR
+      if (id & SCHEDULE_BINARY) {
+        auto &measurement = this->binary_measurements_[id & ~SCHEDULE_BINARY];
+        if (measurement.sensor->has_state()) {
+          size_t len = bthome_codec::encode_binary(this->adv_data_ + pos, payload_end - pos, measurement.object_id,
+                                                   measurement.sensor->state);
+          if (this->track_raw_(measurement.last_raw, measurement.last_raw_valid, this->adv_data_ + pos, len,
+                               keyframe)) {
+            pos += len;
+          }
+        }
+        continue;
       }
-    }
 #endif
+#ifdef USE_SENSOR
+      auto &measurement = this->measurements_[id];
+      if (!measurement.sensor->has_state() || std::isnan(measurement.sensor->state))
+        continue;
 
-#ifdef USE_BINARY_SENSOR
-    if (!this->binary_measurements_.empty()) {
-      size_t start_idx = this->current_binary_index_;
-      size_t count = this->binary_measurements_.size();
-      size_t added = 0;
-
-      // Rotate through binary measurements starting from current index
-      for (size_t i = 0; i < count; i++) {
-        size_t idx = (start_idx + i) % count;
-        const auto &measurement = this->binary_measurements_[idx];
-
-        if (!measurement.sensor->has_state())
-          continue;
-
-        if (pos + 2 > MAX_BLE_ADVERTISEMENT_SIZE)
-          break;
-
-        pos += this->encode_binary_measurement_(this->adv_data_ + pos, MAX_BLE_ADVERTISEMENT_SIZE - pos,
-                                                 measurement.object_id, measurement.sensor->state);
-        added++;
-      }
+      // Queued events in the same advertisement can take the room the schedule planned for
+      if (pos + 1 + measurement.data_bytes > payload_end)
+        continue;
 
-      // Advance index for next advertisement
-      if (added > 0 && added < count) {
-        this->current_binary_index_ = (start_idx + added) % count;
+      size_t len = this->encode_measurement_(this->adv_data_ + pos, payload_end - pos, measurement);
+      if (this->track_raw_(measurement.last_raw, measurement.last_raw_valid, this->adv_data_ + pos, len, keyframe)) {
+        pos += len;
       }
-    }
 #endif
+    }
   }
 
   size_t measurement_len = pos - measurement_start;
 
   // Handle encryption
   if (this->encryption_enabled_ && measurement_len > 0) {
-    uint8_t plaintext[MAX_BLE_ADVERTISEMENT_SIZE];
+    uint8_t plaintext[ADV_BUFFER_SIZE];
     memcpy(plaintext, this->adv_data_ + measurement_start, measurement_len);
 
-    uint8_t ciphertext[MAX_BLE_ADVERTISEMENT_SIZE];
+    // Encryption output is ciphertext followed by the 4-byte MIC
+    uint8_t ciphertext[ADV_BUFFER_SIZE + bthome_codec::MIC_SIZE];
     size_t ciphertext_len = 0;
 
     if (this->encrypt_payload_(plaintext, measurement_len, ciphertext, &ciphertext_len)) {
-      memcpy(this->adv_data_ + measurement_start, ciphertext, ciphertext_len);
-      pos = measurement_start + ciphertext_len;
-
-      // Add counter (4 bytes, little-endian)
-      this->adv_data_[pos++] = this->counter_ & 0xFF;
-      this->adv_data_[pos++] = (this->counter_ >> 8) & 0xFF;
-      this->adv_data_[pos++] = (this->counter_ >> 16) & 0xFF;
-      this->adv_data_[pos++] = (this->counter_ >> 24) & 0xFF;
+      // Frame: ciphertext + counter(4) + MIC(4)
+      memcpy(this->adv_data_ + measurement_start, ciphertext, measurement_len);
+      pos = measurement_start + measurement_len;
+      pos += bthome_codec::write_encrypted_trailer(this->adv_data_ + pos, this->max_adv_size_() - pos,
+                                                   this->counter_, ciphertext + measurement_len);
 
       this->counter_++;
+      // Reserve the next block once half of this one is used, well before it runs out
+      if (this->counter_reservation_ > 0 &&
+          this->counter_reserved_until_ - this->counter_ <= this->counter_reservation_ / 2) {
+        this->request_counter_reservation_();
+      }
     }
   }
 
@@ -567,11 +827,112 @@ void BTHome::build_advertisement_data_() {
   this->packet_id_++;
 
   ESP_LOGD(TAG, "Built advertisement data (%zu bytes, packet_id=%u)", this->adv_data_len_, (uint8_t)(this->packet_id_ - 1));
+  if (this->schedule_starts_.size() > 2) {
+    ESP_LOGD(TAG, "  Rotation frame: %zu/%zu", this->current_frame_ + 1, this->schedule_starts_.size() - 1);
+  }
+}
+
+// First-fit decreasing over a fixed number of frames. An item with a period appears
+// ceil(frame_count / period) times at evenly spread frames, so no gap between two of its
+// frames (wrapping around) exceeds the period. Items appearing most often and then the
+// largest are placed first, each in the first frames that still have room.
+void BTHome::build_schedule_() {
+  // A measurement with max_staleness must be in at least every period-th frame
+  auto period = [this](uint32_t max_staleness) -> uint16_t {
+    if (max_staleness == 0) {
+      return 0;
+    }
+    return std::max<uint32_t>(1, std::min<uint32_t>(max_staleness / this->rotation_interval_, UINT16_MAX));
+  };
+
+  std::vector<ScheduleItem> items;
 #ifdef USE_SENSOR
-  if (this->measurements_.size() > 1) {
-    ESP_LOGD(TAG, "  Sensor rotation index: %zu/%zu", this->current_sensor_index_, this->measurements_.size());
+  for (size_t i = 0; i < this->measurements_.size(); i++) {
+    const auto &measurement = this->measurements_[i];
+    items.push_back({(uint16_t) i, (uint8_t) (1 + measurement.data_bytes), period(measurement.max_staleness)});
+  }
+#endif
+#ifdef USE_BINARY_SENSOR
+  for (size_t i = 0; i < this->binary_measurements_.size(); i++) {
+    const auto &measurement = this->binary_measurements_[i];
+    items.push_back({(uint16_t) (i | SCHEDULE_BINARY), 2, period(measurement.max_staleness)});
   }
 #endif
+
+  std::vector<std::vector<uint16_t>> frames;
+  switch (bthome_codec::build_schedule(items, this->payload_capacity_(), BTHOME_MAX_ADV_PACKETS, frames)) {
+    case bthome_codec::ScheduleResult::PERIODS_DROPPED:
+      ESP_LOGW(TAG, "max_staleness cannot be met for all measurements at a %ums rotation interval",
+               this->rotation_interval_);
+      break;
+    case bthome_codec::ScheduleResult::ITEM_TOO_LARGE:
+      ESP_LOGE(TAG, "A measurement does not fit in an advertisement");
+      break;
+    default:
+      break;
+  }
+
+  this->schedule_items_.clear();
+  this->schedule_starts_.clear();
+  this->schedule_starts_.push_back(0);
+  for (const auto &frame : frames) {
+    this->schedule_items_.insert(this->schedule_items_.end(), frame.begin(), frame.end());
+    this->schedule_starts_.push_back(this->schedule_items_.size());
+  }
+  this->current_frame_ = 0;
+
+  size_t frame_count = frames.size();
+  if (frame_count > 1) {
+    // Rebuilding on data changes keeps the current frame; the timer moves to the next one
+    this->set_interval("rotation", this->rotation_interval_, [this, frame_count]() {
+      this->current_frame_ = (this->current_frame_ + 1) % frame_count;
+      this->data_changed_ = true;
+#ifdef USE_ESP32
+      this->enable_loop();
+#endif
+    });
+  } else {
+    this->cancel_interval("rotation");
+  }
+}
+
+bool BTHome::track_raw_(uint32_t &last_raw, bool &last_raw_valid, const uint8_t *data, size_t len, bool keyframe) {
+  if (len < 2) {
+    return len > 0;
+  }
+  // The value bytes after the object ID, little-endian, as the integer they were encoded from
+  uint32_t raw = 0;
+  for (size_t i = len - 1; i > 0; i--) {
+    raw = (raw << 8) | data[i];
+  }
+  bool unchanged = last_raw_valid && raw == last_raw;
+  last_raw = raw;
+  last_raw_valid = true;
+  return keyframe || !unchanged;
+}
+
+size_t BTHome::max_frame_gap_(uint16_t id) const {
+  const size_t frame_count = this->schedule_starts_.size() - 1;
+  size_t first = frame_count;
+  size_t last = 0;
+  size_t gap = 0;
+  for (size_t frame = 0; frame < frame_count; frame++) {
+    auto begin = this->schedule_items_.begin() + this->schedule_starts_[frame];
+    auto end = this->schedule_items_.begin() + this->schedule_starts_[frame + 1];
+    if (std::find(begin, end, id) == end) {
+      continue;
+    }
+    if (first == frame_count) {
+      first = frame;
+    } else {
+      gap = std::max(gap, frame - last);
+    }
+    last = frame;
+  }
+  if (first == frame_count) {
+    return 0;
+  }
+  return std::max(gap, frame_count - last + first);
 }
 
 void BTHome::build_scan_response_data_() {
@@ -632,6 +993,72 @@ void BTHome::start_advertising_() {
     return;
   }
 
+    #ifdef USE_BTHOME_EXTENDED_ADV
+  if (this->extended_active_) {
+    // Frames that fit a legacy PDU are sent as one, so legacy scanners receive them as well
+    bool legacy_pdu = this->adv_data_len_ <= MAX_BLE_ADVERTISEMENT_SIZE;
+    size_t max_len = legacy_pdu ? MAX_BLE_ADVERTISEMENT_SIZE : MAX_EXT_ADVERTISEMENT_SIZE;
+
+    // Non-connectable and non-scannable, so the scan response elements ride in the advertisement
+    uint8_t data[ADV_BUFFER_SIZE];
+    size_t data_len = this->adv_data_len_;
+    memcpy(data, this->adv_data_, data_len);
+    if (data_len + this->scan_rsp_data_len_ <= max_len) {
+      memcpy(data + data_len, this->scan_rsp_data_, this->scan_rsp_data_len_);
+      data_len += this->scan_rsp_data_len_;
+    }
+
+    int rc;
+    if (!this->ext_adv_configured_ || legacy_pdu != this->ext_adv_legacy_pdu_) {
+      struct ble_gap_ext_adv_params ext_params;
+      memset(&ext_params, 0, sizeof(ext_params));
+      ext_params.legacy_pdu = legacy_pdu;
+      ext_params.own_addr_type = this->nimble_own_addr_type_;
+      ext_params.primary_phy = BLE_HCI_LE_PHY_1M;
+      ext_params.secondary_phy = BLE_HCI_LE_PHY_1M;
+      ext_params.itvl_min = static_cast<uint32_t>(this->min_interval_ / 0.625f);
+      ext_params.itvl_max = static_cast<uint32_t>(this->max_interval_ / 0.625f);
+      ext_params.tx_power = 127;  // No preference
+      rc = ble_gap_ext_adv_configure(EXT_ADV_INSTANCE, &ext_params, nullptr, nullptr, nullptr);
+      if (rc != 0) {
+        ESP_LOGE(TAG, "ble_gap_ext_adv_configure failed: %d", rc);
+        this->request_legacy_fallback_();
+        return;
+      }
+      this->ext_adv_configured_ = true;
+      this->ext_adv_legacy_pdu_ = legacy_pdu;
+    }
+
+    struct os_mbuf *buf = os_msys_get_pkthdr(data_len, 0);
+    if (buf == nullptr) {
+      ESP_LOGE(TAG, "No mbuf for extended advertisement data");
+      return;
+    }
+    if (os_mbuf_append(buf, data, data_len) != 0) {
+      ESP_LOGE(TAG, "No room in mbuf for extended advertisement data");
+      os_mbuf_free_chain(buf);
+      return;
+    }
+    // Takes ownership of buf, also on failure
+    rc = ble_gap_ext_adv_set_data(EXT_ADV_INSTANCE, buf);
+    if (rc != 0) {
+      ESP_LOGE(TAG, "ble_gap_ext_adv_set_data failed: %d", rc);
+      this->request_legacy_fallback_();
+      return;
+    }
+
+    ESP_LOGD(TAG, "Starting NimBLE extended advertising (%zu bytes)", data_len);
+    rc = ble_gap_ext_adv_start(EXT_ADV_INSTANCE, 0, 0);
+    if (rc != 0) {
+      ESP_LOGE(TAG, "ble_gap_ext_adv_start failed: %d", rc);
+      this->request_legacy_fallback_();
+      return;
+    }
+    this->advertising_ = true;
+    return;
+  }
+    #endif
+
   // Set raw advertisement data
   int rc = ble_gap_adv_set_data(this->adv_data_, this->adv_data_len_);
   if (rc != 0) {
@@ -764,6 +1191,50 @@ void BTHome::start_advertising_() {
     sd_count++;
   }
 
+#ifdef USE_BTHOME_EXTENDED_ADV
+  if (this->extended_active_) {
+    if (this->ext_adv_ == nullptr) {
+      struct bt_le_adv_param ext_param = this->adv_param_;
+      ext_param.options |= BT_LE_ADV_OPT_EXT_ADV;
+      int err = bt_le_ext_adv_create(&ext_param, nullptr, &this->ext_adv_);
+      if (err) {
+        ESP_LOGE(TAG, "Extended advertising set creation failed (err %d)", err);
+        this->ext_adv_ = nullptr;
+        this->request_legacy_fallback_();
+        return;
+      }
+    }
+
+    // Non-scannable, so the scan response elements that fit ride in the advertisement
+    struct bt_data ad[2 + 5];
+    size_t ad_count = 0;
+    size_t ad_len = 0;
+    for (size_t i = 0; i < 2 + sd_count; i++) {
+      const struct bt_data &element = i < 2 ? this->ad_[i] : this->sd_[i - 2];
+      if (ad_len + 2 + element.data_len > MAX_EXT_ADVERTISEMENT_SIZE) {
+        continue;
+      }
+      ad[ad_count++] = element;
+      ad_len += 2 + element.data_len;
+    }
+    int err = bt_le_ext_adv_set_data(this->ext_adv_, ad, ad_count, nullptr, 0);
+    if (err) {
+      ESP_LOGE(TAG, "Extended advertising data rejected (err %d)", err);
+      this->request_legacy_fallback_();
+      return;
+    }
+    err = bt_le_ext_adv_start(this->ext_adv_, BT_LE_EXT_ADV_START_DEFAULT);
+    if (err) {
+      ESP_LOGE(TAG, "Extended advertising failed to start (err %d)", err);
+      this->request_legacy_fallback_();
+      return;
+    }
+    this->advertising_ = true;
+    ESP_LOGD(TAG, "BTHome extended advertising started (%zu bytes)", ad_len);
+    return;
+  }
+#endif
+
   int err = bt_le_adv_start(&this->adv_param_, this->ad_, 2,
                             sd_count > 0 ? this->sd_ : nullptr, sd_count);
   if (err) {
@@ -780,7 +1251,15 @@ void BTHome::stop_advertising_() {
 #ifdef USE_ESP32
   #ifdef USE_BTHOME_NIMBLE
   if (this->advertising_) {
+    #ifdef USE_BTHOME_EXTENDED_ADV
+    if (this->extended_active_) {
+      ble_gap_ext_adv_stop(EXT_ADV_INSTANCE);
+    } else {
+      ble_gap_adv_stop();
+    }
+    #else
     ble_gap_adv_stop();
+    #endif
     this->advertising_ = false;
   }
   #else
@@ -792,12 +1271,31 @@ void BTHome::stop_advertising_() {
 
 #ifdef USE_NRF52
   if (this->advertising_) {
+#ifdef USE_BTHOME_EXTENDED_ADV
+    if (this->extended_active_) {
+      bt_le_ext_adv_stop(this->ext_adv_);
+    } else {
+      bt_le_adv_stop();
+    }
+#else
     bt_le_adv_stop();
+#endif
     this->advertising_ = false;
   }
 #endif
 }
 
+#ifdef USE_BTHOME_EXTENDED_ADV
+void BTHome::request_legacy_fallback_() {
+  ESP_LOGW(TAG, "Extended advertising unavailable, falling back to legacy advertisements");
+  this->extended_active_ = false;
+  this->legacy_fallback_pending_ = true;
+#ifdef USE_ESP32
+  this->enable_loop_soon_any_context();
+#endif
+}
+#endif
+
 #if defined(USE_ESP32) && defined(USE_BTHOME_NIMBLE)
 // NimBLE static callbacks
 void BTHome::nimble_host_task_(void *param) {
@@ -825,6 +1323,10 @@ void BTHome::nimble_on_sync_() {
 void BTHome::nimble_on_reset_(int reason) {
   ESP_LOGW(TAG, "NimBLE host reset, reason: %d", reason);
   instance_->advertising_ = false;
+#ifdef USE_BTHOME_EXTENDED_ADV
+  // The controller forgot the advertising instance
+  instance_->ext_adv_configured_ = false;
+#endif
 }
 #endif
 
@@ -835,173 +1337,49 @@ void BTHome::gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_para
 }
 #endif
 
-#ifdef USE_SENSOR
-size_t BTHome::encode_measurement_(uint8_t *data, size_t max_len, const SensorMeasurement &measurement) {
-  // Generic BTHome v2 sensor encoding
-  // Uses data_bytes, is_signed, and factor from the measurement struct
-  // See: https://bthome.io/format/
-
-  size_t required_size = 1 + measurement.data_bytes;  // object_id + value bytes
-  if (max_len < required_size) {
-    return 0;
-  }
-
-  float value = measurement.sensor->state;
-  size_t pos = 0;
-
-  // Object ID
-  data[pos++] = measurement.object_id;
-
-  // Convert value to encoded integer using factor
-  // Factor in Python is the resolution (e.g., 0.01 means value * 100)
-  // So we divide by factor to get the encoded value
-  double scaled = std::round(value / measurement.factor);
-
-  // Encode based on data_bytes and signedness (little-endian)
-  if (measurement.is_signed) {
-    // Signed integer encoding
-    int32_t encoded;
-    switch (measurement.data_bytes) {
-      case 1:
-        encoded = static_cast<int8_t>(std::max(-128.0, std::min(127.0, scaled)));
-        data[pos++] = encoded & 0xFF;
-        break;
-      case 2:
-        encoded = static_cast<int16_t>(std::max(-32768.0, std::min(32767.0, scaled)));
-        data[pos++] = encoded & 0xFF;
-        data[pos++] = (encoded >> 8) & 0xFF;
-        break;
-      case 3:
-        // sint24 - range: -8388608 to 8388607
-        encoded = static_cast<int32_t>(std::max(-8388608.0, std::min(8388607.0, scaled)));
-        data[pos++] = encoded & 0xFF;
-        data[pos++] = (encoded >> 8) & 0xFF;
-        data[pos++] = (encoded >> 16) & 0xFF;
-        break;
-      case 4:
-        encoded = static_cast<int32_t>(scaled);
-        data[pos++] = encoded & 0xFF;
-        data[pos++] = (encoded >> 8) & 0xFF;
-        data[pos++] = (encoded >> 16) & 0xFF;
-        data[pos++] = (encoded >> 24) & 0xFF;
-        break;
-      default:
-        ESP_LOGW(TAG, "Unsupported data_bytes: %d for object 0x%02X", measurement.data_bytes, measurement.object_id);
-        return 0;
-    }
-  } else {
-    // Unsigned integer encoding
-    uint32_t encoded;
-    switch (measurement.data_bytes) {
-      case 1:
-        encoded = static_cast<uint8_t>(std::max(0.0, std::min(255.0, scaled)));
-        data[pos++] = encoded & 0xFF;
-        break;
-      case 2:
-        encoded = static_cast<uint16_t>(std::max(0.0, std::min(65535.0, scaled)));
-        data[pos++] = encoded & 0xFF;
-        data[pos++] = (encoded >> 8) & 0xFF;
-        break;
-      case 3:
-        // uint24 - range: 0 to 16777215
-        encoded = static_cast<uint32_t>(std::max(0.0, std::min(16777215.0, scaled)));
-        data[pos++] = encoded & 0xFF;
-        data[pos++] = (encoded >> 8) & 0xFF;
-        data[pos++] = (encoded >> 16) & 0xFF;
-        break;
-      case 4:
-        encoded = static_cast<uint32_t>(std::max(0.0, scaled));
-        data[pos++] = encoded & 0xFF;
-        data[pos++] = (encoded >> 8) & 0xFF;
-        data[pos++] = (encoded >> 16) & 0xFF;
-        data[pos++] = (encoded >> 24) & 0xFF;
-        break;
-      default:
-        ESP_LOGW(TAG, "Unsupported data_bytes: %d for object 0x%02X", measurement.data_bytes, measurement.object_id);
-        return 0;
-    }
+void BTHome::record_immediate_latency_(uint32_t latency_ms) {
+  this->immediate_latency_count_++;
+  this->immediate_latency_total_ms_ += latency_ms;
+  if (latency_ms > this->immediate_latency_max_ms_) {
+    this->immediate_latency_max_ms_ = latency_ms;
   }
-
-  return pos;
+  ESP_LOGD(TAG, "Immediate value latency: %ums (avg %ums, max %ums)", latency_ms, this->get_immediate_latency_avg_ms(),
+           this->immediate_latency_max_ms_);
 }
-#endif
 
-#ifdef USE_BINARY_SENSOR
-size_t BTHome::encode_binary_measurement_(uint8_t *data, size_t max_len, uint8_t object_id, bool value) {
-  // Binary sensors are always encoded as: [object_id] [0x00 or 0x01]
-  // See: https://bthome.io/format/
-  //
-  // BTHome v2 binary sensor object IDs:
-  //   0x0F - generic_boolean (generic on/off)
-  //   0x10 - power (power on/off)
-  //   0x11 - opening (open/closed)
-  //   0x15 - battery_low (battery normal/low)
-  //   0x16 - battery_charging (not charging/charging)
-  //   0x17 - carbon_monoxide (CO not detected/detected)
-  //   0x18 - cold (normal/cold)
-  //   0x19 - connectivity (disconnected/connected)
-  //   0x1A - door (closed/open)
-  //   0x1B - garage_door (closed/open)
-  //   0x1C - gas (clear/detected)
-  //   0x1D - heat (normal/hot)
-  //   0x1E - light (no light/light detected)
-  //   0x1F - lock (locked/unlocked)
-  //   0x20 - moisture_binary (dry/wet)
-  //   0x21 - motion (clear/detected)
-  //   0x22 - moving (not moving/moving)
-  //   0x23 - occupancy (clear/detected)
-  //   0x24 - plug (unplugged/plugged in)
-  //   0x25 - presence (away/home)
-  //   0x26 - problem (ok/problem)
-  //   0x27 - running (not running/running)
-  //   0x28 - safety (unsafe/safe)
-  //   0x29 - smoke (clear/detected)
-  //   0x2A - sound (clear/detected)
-  //   0x2B - tamper (off/on)
-  //   0x2C - vibration (clear/detected)
-  //   0x2D - window (closed/open)
-
-  if (max_len < 2) return 0;
-
-  data[0] = object_id;
-  data[1] = value ? 0x01 : 0x00;
-  return 2;
+#ifdef USE_SENSOR
+size_t BTHome::encode_measurement_(uint8_t *data, size_t max_len, const SensorMeasurement &measurement) {
+  // Generic BTHome v2 sensor encoding using data_bytes, is_signed and factor from the measurement
+  size_t len = bthome_codec::encode_value(data, max_len, measurement.object_id, measurement.data_bytes,
+                                          measurement.is_signed, measurement.factor, measurement.sensor->state);
+  if (len == 0 && (measurement.data_bytes < 1 || measurement.data_bytes > 4)) {
+    ESP_LOGW(TAG, "Unsupported data_bytes: %d for object 0x%02X", measurement.data_bytes, measurement.object_id);
+  }
+  return len;
 }
 #endif
 
-size_t BTHome::encode_event_(uint8_t *data, size_t max_len, uint8_t object_id, const uint8_t *event_data, size_t event_data_len) {
-  // Events are encoded as: [object_id] [event_data...]
-  // Button event (0x3A): [object_id] [button_index << 4 | event_type]
-  // Dimmer event (0x3C): [object_id] [steps (signed int8)]
-  
-  size_t total_len = 1 + event_data_len;
-  if (max_len < total_len) return 0;
-  
-  data[0] = object_id;
-  memcpy(data + 1, event_data, event_data_len);
-  return total_len;
-}
-
 bool BTHome::encrypt_payload_(const uint8_t *plaintext, size_t plaintext_len, uint8_t *ciphertext, size_t *ciphertext_len) {
   if (!this->encryption_enabled_) return false;
 
-  // Build nonce: MAC (6) + UUID (2) + device info (1) + counter (4) = 13 bytes
-  uint8_t nonce[13];
+  // Nonce uses the MAC as written (MSB first); NimBLE and Zephyr store addresses LSB first
+  uint8_t mac[6];
 
 #ifdef USE_ESP32
   #ifdef USE_BTHOME_NIMBLE
   // NimBLE: Get MAC address from controller
-  uint8_t mac[6];
-  int rc = ble_hs_id_copy_addr(this->nimble_own_addr_type_, mac, nullptr);
+  uint8_t addr_le[6];
+  int rc = ble_hs_id_copy_addr(this->nimble_own_addr_type_, addr_le, nullptr);
   if (rc != 0) {
     ESP_LOGE(TAG, "Failed to get NimBLE MAC address: %d", rc);
     return false;
   }
-  memcpy(nonce, mac, 6);
+  for (int i = 0; i < 6; i++) {
+    mac[i] = addr_le[5 - i];
+  }
   #else
   // Bluedroid: Get MAC address
-  const uint8_t *mac = esp_bt_dev_get_address();
-  memcpy(nonce, mac, 6);
+  memcpy(mac, esp_bt_dev_get_address(), 6);
   #endif
 #endif
 
@@ -1009,16 +1387,15 @@ bool BTHome::encrypt_payload_(const uint8_t *plaintext, size_t plaintext_len, ui
   bt_addr_le_t addr;
   size_t count = 1;
   bt_id_get(&addr, &count);
-  memcpy(nonce, addr.a.val, 6);
+  for (int i = 0; i < 6; i++) {
+    mac[i] = addr.a.val[5 - i];
+  }
 #endif
 
-  nonce[6] = BTHOME_SERVICE_UUID & 0xFF;
-  nonce[7] = (BTHOME_SERVICE_UUID >> 8) & 0xFF;
-  nonce[8] = this->trigger_based_ ? BTHOME_DEVICE_INFO_TRIGGER_ENCRYPTED : BTHOME_DEVICE_INFO_ENCRYPTED;
-  nonce[9] = this->counter_ & 0xFF;
-  nonce[10] = (this->counter_ >> 8) & 0xFF;
-  nonce[11] = (this->counter_ >> 16) & 0xFF;
-  nonce[12] = (this->counter_ >> 24) & 0xFF;
+  uint8_t nonce[bthome_codec::NONCE_SIZE];
+  bthome_codec::build_nonce(nonce, mac,
+                            this->trigger_based_ ? BTHOME_DEVICE_INFO_TRIGGER_ENCRYPTED : BTHOME_DEVICE_INFO_ENCRYPTED,
+                            this->counter_);
 
 #ifdef USE_ESP32
   #ifdef USE_BTHOME_NIMBLE
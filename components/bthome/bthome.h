@@ -4,6 +4,8 @@
 #include "esphome/core/component.h"
 #include "esphome/core/helpers.h"
 #include "esphome/core/automation.h"
+#include "esphome/core/preferences.h"
+#include "esphome/components/bthome_codec/bthome_codec.h"
 #ifdef USE_SENSOR
 #include "esphome/components/sensor/sensor.h"
 #endif
@@ -12,6 +14,8 @@
 #endif
 
 #include <array>
+#include <bitset>
+#include <vector>
 
 // Platform-specific includes
 #ifdef USE_ESP32
@@ -46,30 +50,39 @@ namespace bthome {
 
 inline constexpr char TAG[] = "bthome";
 
-// BTHome v2 constants
-static const uint16_t BTHOME_SERVICE_UUID = 0xFCD2;
-// Device info byte format: bit 0 = encryption, bit 2 = trigger-based
-static const uint8_t BTHOME_DEVICE_INFO_UNENCRYPTED = 0x40;           // Regular device, no encryption
-static const uint8_t BTHOME_DEVICE_INFO_ENCRYPTED = 0x41;             // Regular device, encrypted
-static const uint8_t BTHOME_DEVICE_INFO_TRIGGER_UNENCRYPTED = 0x44;   // Trigger-based device, no encryption
-static const uint8_t BTHOME_DEVICE_INFO_TRIGGER_ENCRYPTED = 0x45;     // Trigger-based device, encrypted
+// BTHome v2 protocol definitions shared with the receiver
+using bthome_codec::BTHOME_DEVICE_INFO_ENCRYPTED;
+using bthome_codec::BTHOME_DEVICE_INFO_TRIGGER_ENCRYPTED;
+using bthome_codec::BTHOME_DEVICE_INFO_TRIGGER_UNENCRYPTED;
+using bthome_codec::BTHOME_DEVICE_INFO_UNENCRYPTED;
+using bthome_codec::BTHOME_SERVICE_UUID;
+using bthome_codec::BUTTON_EVENT_DOUBLE_PRESS;
+using bthome_codec::BUTTON_EVENT_HOLD_PRESS;
+using bthome_codec::BUTTON_EVENT_LONG_DOUBLE_PRESS;
+using bthome_codec::BUTTON_EVENT_LONG_PRESS;
+using bthome_codec::BUTTON_EVENT_LONG_TRIPLE_PRESS;
+using bthome_codec::BUTTON_EVENT_NONE;
+using bthome_codec::BUTTON_EVENT_PRESS;
+using bthome_codec::BUTTON_EVENT_TRIPLE_PRESS;
+using bthome_codec::ENCRYPTION_OVERHEAD;
+using bthome_codec::OBJECT_ID_BUTTON;
+using bthome_codec::OBJECT_ID_DIMMER;
+using bthome_codec::SCHEDULE_BINARY;
+using bthome_codec::ScheduleItem;
+
 static const size_t MAX_BLE_ADVERTISEMENT_SIZE = 31;
+#ifdef USE_BTHOME_EXTENDED_ADV
+// AdvData one AUX_ADV_IND PDU carries: 255 bytes minus the extended header (AdvA, ADI, TX power)
+static const size_t MAX_EXT_ADVERTISEMENT_SIZE = 244;
+static const size_t ADV_BUFFER_SIZE = MAX_EXT_ADVERTISEMENT_SIZE;
+#ifdef USE_ESP32
+static const uint8_t EXT_ADV_INSTANCE = 0;
+#endif
+#else
+static const size_t ADV_BUFFER_SIZE = MAX_BLE_ADVERTISEMENT_SIZE;
+#endif
 static const size_t MAX_DEVICE_NAME_LENGTH = 20;  // Leave room for other AD elements
 
-// Event object IDs
-static const uint8_t OBJECT_ID_BUTTON = 0x3A;
-static const uint8_t OBJECT_ID_DIMMER = 0x3C;
-
-// Button event types (BTHome v2 spec object ID 0x3A)
-static const uint8_t BUTTON_EVENT_NONE = 0x00;
-static const uint8_t BUTTON_EVENT_PRESS = 0x01;
-static const uint8_t BUTTON_EVENT_DOUBLE_PRESS = 0x02;
-static const uint8_t BUTTON_EVENT_TRIPLE_PRESS = 0x03;
-static const uint8_t BUTTON_EVENT_LONG_PRESS = 0x04;
-static const uint8_t BUTTON_EVENT_LONG_DOUBLE_PRESS = 0x05;
-static const uint8_t BUTTON_EVENT_LONG_TRIPLE_PRESS = 0x06;
-static const uint8_t BUTTON_EVENT_HOLD_PRESS = 0x80;
-
 // Event structure for sending button and dimmer events
 // Packed to 16 bits for efficient storage and passing
 struct BTHomeEvent {
@@ -80,6 +93,14 @@ struct BTHomeEvent {
   } data;
 } __attribute__((packed));
 
+#ifdef BTHOME_USE_EVENTS
+// Events sent in one advertisement: those of one send_events() call, or of several merged calls
+struct EventFrame {
+  BTHomeEvent events[BTHOME_MAX_EVENTS];
+  uint8_t count;
+};
+#endif
+
 #ifdef USE_SENSOR
 struct SensorMeasurement {
   sensor::Sensor *sensor;
@@ -88,6 +109,10 @@ struct SensorMeasurement {
   bool is_signed;          // True for signed integers, false for unsigned
   float factor;            // Multiply raw value by this to get encoded value
   bool advertise_immediately;
+  uint32_t max_staleness;  // Advertise at least this often in the rotation (ms, 0 = no limit)
+  uint32_t changed_time;   // millis() of the first change not yet in an immediate frame
+  uint32_t last_raw;       // Integer last encoded into an advertisement (change-only mode)
+  bool last_raw_valid;
 };
 #endif
 
@@ -96,9 +121,14 @@ struct BinarySensorMeasurement {
   binary_sensor::BinarySensor *sensor;
   uint8_t object_id;
   bool advertise_immediately;
+  uint32_t max_staleness;  // Advertise at least this often in the rotation (ms, 0 = no limit)
+  uint32_t changed_time;   // millis() of the first change not yet in an immediate frame
+  uint32_t last_raw;       // Integer last encoded into an advertisement (change-only mode)
+  bool last_raw_valid;
 };
 #endif
 
+
 #if defined(USE_ESP32) && defined(USE_BTHOME_BLUEDROID)
 using namespace esp32_ble;
 
@@ -116,6 +146,11 @@ class BTHome : public Component {
   void set_max_interval(uint16_t val) { this->max_interval_ = val; }
   void set_retransmit_count(uint8_t count) { this->retransmit_count_ = count; }
   void set_retransmit_interval(uint16_t interval_ms) { this->retransmit_interval_ = interval_ms; }
+  // Time each frame of the rotation stays on air when not all measurements fit in one advertisement
+  void set_rotation_interval(uint32_t interval_ms) { this->rotation_interval_ = interval_ms; }
+  // Change-only mode: periodic frames leave out values already advertised, and a full snapshot
+  // is sent every interval_ms (0 = off, every frame carries all of its values)
+  void set_keyframe_interval(uint32_t interval_ms) { this->keyframe_interval_ = interval_ms; }
 
 #ifdef USE_ESP32
   void set_tx_power(int val) { this->tx_power_esp32_ = static_cast<esp_power_level_t>(val); }
@@ -129,12 +164,23 @@ class BTHome : public Component {
   void set_trigger_based(bool trigger_based) { this->trigger_based_ = trigger_based; }
 
   void set_encryption_key(const std::array<uint8_t, 16> &key);
+  // Persist the encryption counter in blocks: reserve counter + reservation in flash every
+  // reservation packets and resume from the reserved value at boot (0 = counter not persisted)
+  void set_counter_reservation(uint32_t reservation) { this->counter_reservation_ = reservation; }
+  uint32_t get_counter_reservation() const { return this->counter_reservation_; }
+  uint32_t get_counter_flash_writes() const { return this->counter_flash_writes_; }
+  // Time from an advertise_immediately sensor's change to the start of the frame carrying it
+  uint32_t get_immediate_latency_avg_ms() const {
+    return this->immediate_latency_count_ == 0 ? 0 : this->immediate_latency_total_ms_ / this->immediate_latency_count_;
+  }
+  uint32_t get_immediate_latency_max_ms() const { return this->immediate_latency_max_ms_; }
 #ifdef USE_SENSOR
   void add_measurement(sensor::Sensor *sensor, uint8_t object_id, uint8_t data_bytes,
-                       bool is_signed, float factor, bool advertise_immediately);
+                       bool is_signed, float factor, bool advertise_immediately, uint32_t max_staleness = 0);
 #endif
 #ifdef USE_BINARY_SENSOR
-  void add_binary_measurement(binary_sensor::BinarySensor *sensor, uint8_t object_id, bool advertise_immediately);
+  void add_binary_measurement(binary_sensor::BinarySensor *sensor, uint8_t object_id, bool advertise_immediately,
+                              uint32_t max_staleness = 0);
 #endif
 
 #ifdef BTHOME_USE_EVENTS
@@ -142,6 +188,10 @@ class BTHome : public Component {
   void send_events(const BTHomeEvent *events, size_t count);
   void send_button_event(uint8_t index, uint8_t action);
   void send_dim_event(uint8_t index, int8_t step);
+
+  // Event frames lost because the queue was full, and calls merged into an already queued frame
+  uint32_t get_events_dropped() const { return this->events_dropped_; }
+  uint32_t get_events_merged() const { return this->events_merged_; }
 #endif
 
 #if defined(USE_ESP32) && defined(USE_BTHOME_BLUEDROID)
@@ -151,19 +201,49 @@ class BTHome : public Component {
  protected:
   void build_advertisement_data_();
   void build_scan_response_data_();
+  // Largest advertisement data: one extended PDU, or a legacy 31-byte advertisement
+  size_t max_adv_size_() const {
+#ifdef USE_BTHOME_EXTENDED_ADV
+    if (this->extended_active_) {
+      return MAX_EXT_ADVERTISEMENT_SIZE;
+    }
+#endif
+    return MAX_BLE_ADVERTISEMENT_SIZE;
+  }
+  // Bytes available for measurement objects after the header, packet ID and encryption trailer
+  size_t payload_capacity_() const {
+    return bthome_codec::payload_capacity(this->max_adv_size_(), this->encryption_enabled_);
+  }
+  // Assign the measurements to the frames of the rotation, and rotate while there is more than one
+  void build_schedule_();
+  // Largest number of frames between two advertisements of a schedule item, wrapping around
+  size_t max_frame_gap_(uint16_t id) const;
+  // Remember the raw value of the object of len bytes just encoded at data. Returns false when
+  // change-only mode leaves it out: the same value was advertised before and no keyframe is due.
+  bool track_raw_(uint32_t &last_raw, bool &last_raw_valid, const uint8_t *data, size_t len, bool keyframe);
   void start_advertising_();
   void stop_advertising_();
+#ifdef USE_BTHOME_EXTENDED_ADV
+  // The controller refused the extended advertising set: switch to legacy advertising from loop()
+  void request_legacy_fallback_();
+#endif
 #ifdef USE_SENSOR
   size_t encode_measurement_(uint8_t *data, size_t max_len, const SensorMeasurement &measurement);
 #endif
-#ifdef USE_BINARY_SENSOR
-  size_t encode_binary_measurement_(uint8_t *data, size_t max_len, uint8_t object_id, bool value);
-#endif
-  size_t encode_event_(uint8_t *data, size_t max_len, uint8_t object_id, const uint8_t *event_data, size_t event_data_len);
   bool encrypt_payload_(const uint8_t *plaintext, size_t plaintext_len, uint8_t *ciphertext, size_t *ciphertext_len);
   void trigger_immediate_sensor_advertising_(uint8_t measurement_index, bool is_binary);
+  // Disable loop() (ESP32) unless immediate values or event frames are still queued
+  void disable_loop_if_idle_();
+  void load_counter_();
+  // Persist the next block of counters (main loop only: writes and syncs flash)
+  void reserve_counters_();
+  // Have loop() reserve the next block; safe from any task
+  void request_counter_reservation_();
 #ifdef BTHOME_USE_EVENTS
   void trigger_immediate_event_advertising_(const BTHomeEvent *events, size_t count);
+  // Merge events into a queued frame if no button or dimmer gets two different events; false if not
+  bool merge_events_(EventFrame &frame, const BTHomeEvent *events, size_t count) const;
+  bool has_pending_events_() const { return this->event_queue_count_ > 0; }
 #endif
 
   // Measurements storage
@@ -195,32 +275,63 @@ class BTHome : public Component {
   bool encryption_enabled_{false};
   std::array<uint8_t, 16> encryption_key_{};
   uint32_t counter_{0};
+  uint32_t counter_reservation_{0};
+  uint32_t counter_reserved_until_{0};  // First counter not covered by the persisted reservation
+  uint32_t counter_flash_writes_{0};
+  ESPPreferenceObject counter_pref_;
+  volatile bool counter_reservation_pending_{false};  // Set when building advertisements, on any task
 
   // Packet ID for deduplication (increments only when data changes, not on retransmits)
   uint8_t packet_id_{0};
 
   // Advertisement data
-  uint8_t adv_data_[MAX_BLE_ADVERTISEMENT_SIZE];
+  uint8_t adv_data_[ADV_BUFFER_SIZE];
   size_t adv_data_len_{0};
   bool data_changed_{true};
+#ifdef USE_BTHOME_EXTENDED_ADV
+  // Cleared for good when the extended advertising set cannot be used
+  bool extended_active_{true};
+  volatile bool legacy_fallback_pending_{false};  // Set from the NimBLE host task
+#endif
+
+  // Measurement rotation (for splitting across multiple packets): the schedule's frames are
+  // stored back to back, frame f being schedule_items_[schedule_starts_[f]..schedule_starts_[f + 1])
+  std::vector<uint16_t> schedule_items_;
+  std::vector<uint16_t> schedule_starts_;
+  size_t current_frame_{0};
+  uint32_t rotation_interval_{5000};
 
-  // Measurement rotation (for splitting across multiple packets)
-  size_t current_sensor_index_{0};
-  size_t current_binary_index_{0};
+  // Change-only mode: full frames are sent for one rotation cycle from keyframe_start_
+  uint32_t keyframe_interval_{0};
+  uint32_t keyframe_start_{0};
 
   // Scan response data (device name + manufacturer)
   uint8_t scan_rsp_data_[MAX_BLE_ADVERTISEMENT_SIZE];
   size_t scan_rsp_data_len_{0};
 
-  // Immediate advertising
+  // Immediate advertising: advertise_immediately sensors changed since their last immediate frame.
+  // A frame carries every dirty value that fits; the rest spill into the next one.
   bool immediate_advertising_pending_{false};
-  uint8_t immediate_adv_measurement_index_{0};
-  bool immediate_adv_is_binary_{false};
-  
+#ifdef USE_SENSOR
+  std::bitset<BTHOME_MAX_MEASUREMENTS> immediate_dirty_;
+#endif
+#ifdef USE_BINARY_SENSOR
+  std::bitset<BTHOME_MAX_BINARY_MEASUREMENTS> immediate_binary_dirty_;
+#endif
+  uint32_t last_immediate_frame_time_{0};
+  void record_immediate_latency_(uint32_t latency_ms);
+  uint32_t immediate_latency_count_{0};
+  uint64_t immediate_latency_total_ms_{0};
+  uint32_t immediate_latency_max_ms_{0};
+
 #ifdef BTHOME_USE_EVENTS
-  // Immediate event advertising
-  BTHomeEvent immediate_event_data_[BTHOME_MAX_EVENTS];
-  size_t immediate_event_count_{0};
+  // Event frames waiting to be advertised, oldest first. Each is sent in its own advertisement
+  // with a new packet ID and the full retransmit count.
+  std::array<EventFrame, BTHOME_EVENT_QUEUE_SIZE> event_queue_;
+  uint8_t event_queue_head_{0};
+  uint8_t event_queue_count_{0};
+  uint32_t events_dropped_{0};
+  uint32_t events_merged_{0};
 #endif
 
   // Platform-specific members
@@ -231,6 +342,12 @@ class BTHome : public Component {
     // NimBLE-specific members
     uint8_t nimble_own_addr_type_{0};
     bool nimble_initialized_{false};
+    #ifdef USE_BTHOME_EXTENDED_ADV
+    // The advertising instance is configured once, and again only when the data switches
+    // between fitting a legacy PDU and needing an extended one
+    bool ext_adv_configured_{false};
+    bool ext_adv_legacy_pdu_{false};
+    #endif
     static BTHome *instance_;  // For NimBLE callbacks
     static void nimble_host_task_(void *param);
     static void nimble_on_sync_();
@@ -248,6 +365,9 @@ class BTHome : public Component {
   struct bt_le_adv_param adv_param_;
   struct bt_data ad_[2];
   struct bt_data sd_[5];  // Scan response data (service UUID, TX power, appearance, name, manufacturer)
+#ifdef USE_BTHOME_EXTENDED_ADV
+  struct bt_le_ext_adv *ext_adv_{nullptr};
+#endif
 #endif
 };
 
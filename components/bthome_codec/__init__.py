@@ -0,0 +1,11 @@
+"""
+BTHome v2 Codec for ESPHome
+
+Platform-independent encoding and decoding of BTHome v2 payloads, shared by the
+bthome (sender) and bthome_receiver components. Loaded automatically by them;
+it has no configuration of its own.
+
+Protocol specification: https://bthome.io/format/
+"""
+
+CODEOWNERS = ["@esphome/core"]
@@ -0,0 +1,360 @@
+#include "bthome_codec.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace esphome {
+namespace bthome_codec {
+
+// BTHome v2 object definitions
+// Format: object_id -> (name, factor, data_bytes, is_signed, kind)
+// Text and raw objects are length-prefixed, so their data_bytes is 0
+struct ObjectTypeEntry {
+  uint8_t object_id;
+  ObjectTypeInfo info;
+};
+
+static constexpr ObjectTypeEntry OBJECT_TYPE_ENTRIES[] = {
+    {0x00, {"packet_id", 1.0f, 1, false, ObjectKind::SENSOR}},
+    {0x01, {"battery", 1.0f, 1, false, ObjectKind::SENSOR}},
+    {0x02, {"temperature", 0.01f, 2, true, ObjectKind::SENSOR}},
+    {0x03, {"humidity", 0.01f, 2, false, ObjectKind::SENSOR}},
+    {0x04, {"pressure", 0.01f, 3, false, ObjectKind::SENSOR}},
+    {0x05, {"illuminance", 0.01f, 3, false, ObjectKind::SENSOR}},
+    {0x06, {"mass_kg", 0.01f, 2, false, ObjectKind::SENSOR}},
+    {0x07, {"mass_lb", 0.01f, 2, false, ObjectKind::SENSOR}},
+    {0x08, {"dewpoint", 0.01f, 2, true, ObjectKind::SENSOR}},
+    {0x09, {"count", 1.0f, 1, false, ObjectKind::SENSOR}},
+    {0x0A, {"energy", 0.001f, 3, false, ObjectKind::SENSOR}},
+    {0x0B, {"power", 0.01f, 3, false, ObjectKind::SENSOR}},
+    {0x0C, {"voltage", 0.001f, 2, false, ObjectKind::SENSOR}},
+    {0x0D, {"pm2_5", 1.0f, 2, false, ObjectKind::SENSOR}},
+    {0x0E, {"pm10", 1.0f, 2, false, ObjectKind::SENSOR}},
+    {0x0F, {"generic_boolean", 1.0f, 1, false, ObjectKind::BINARY_SENSOR}},
+    {0x10, {"power_binary", 1.0f, 1, false, ObjectKind::BINARY_SENSOR}},
+    {0x11, {"opening", 1.0f, 1, false, ObjectKind::BINARY_SENSOR}},
+    {0x12, {"co2", 1.0f, 2, false, ObjectKind::SENSOR}},
+    {0x13, {"tvoc", 1.0f, 2, false, ObjectKind::SENSOR}},
+    {0x14, {"moisture", 0.01f, 2, false, ObjectKind::SENSOR}},
+    {0x15, {"battery_low", 1.0f, 1, false, ObjectKind::BINARY_SENSOR}},
+    {0x16, {"battery_charging", 1.0f, 1, false, ObjectKind::BINARY_SENSOR}},
+    {0x17, {"carbon_monoxide", 1.0f, 1, false, ObjectKind::BINARY_SENSOR}},
+    {0x18, {"cold", 1.0f, 1, false, ObjectKind::BINARY_SENSOR}},
+    {0x19, {"connectivity", 1.0f, 1, false, ObjectKind::BINARY_SENSOR}},
+    {0x1A, {"door", 1.0f, 1, false, ObjectKind::BINARY_SENSOR}},
+    {0x1B, {"garage_door", 1.0f, 1, false, ObjectKind::BINARY_SENSOR}},
+    {0x1C, {"gas", 1.0f, 1, false, ObjectKind::BINARY_SENSOR}},
+    {0x1D, {"heat", 1.0f, 1, false, ObjectKind::BINARY_SENSOR}},
+    {0x1E, {"light", 1.0f, 1, false, ObjectKind::BINARY_SENSOR}},
+    {0x1F, {"lock", 1.0f, 1, false, ObjectKind::BINARY_SENSOR}},
+    {0x20, {"moisture_binary", 1.0f, 1, false, ObjectKind::BINARY_SENSOR}},
+    {0x21, {"motion", 1.0f, 1, false, ObjectKind::BINARY_SENSOR}},
+    {0x22, {"moving", 1.0f, 1, false, ObjectKind::BINARY_SENSOR}},
+    {0x23, {"occupancy", 1.0f, 1, false, ObjectKind::BINARY_SENSOR}},
+    {0x24, {"plug", 1.0f, 1, false, ObjectKind::BINARY_SENSOR}},
+    {0x25, {"presence", 1.0f, 1, false, ObjectKind::BINARY_SENSOR}},
+    {0x26, {"problem", 1.0f, 1, false, ObjectKind::BINARY_SENSOR}},
+    {0x27, {"running", 1.0f, 1, false, ObjectKind::BINARY_SENSOR}},
+    {0x28, {"safety", 1.0f, 1, false, ObjectKind::BINARY_SENSOR}},
+    {0x29, {"smoke", 1.0f, 1, false, ObjectKind::BINARY_SENSOR}},
+    {0x2A, {"sound", 1.0f, 1, false, ObjectKind::BINARY_SENSOR}},
+    {0x2B, {"tamper", 1.0f, 1, false, ObjectKind::BINARY_SENSOR}},
+    {0x2C, {"vibration", 1.0f, 1, false, ObjectKind::BINARY_SENSOR}},
+    {0x2D, {"window", 1.0f, 1, false, ObjectKind::BINARY_SENSOR}},
+    {0x2E, {"humidity_uint8", 1.0f, 1, false, ObjectKind::SENSOR}},
+    {0x2F, {"moisture_uint8", 1.0f, 1, false, ObjectKind::SENSOR}},
+    {0x3A, {"button", 1.0f, 1, false, ObjectKind::BUTTON}},
+    {0x3C, {"dimmer", 1.0f, 1, true, ObjectKind::DIMMER}},
+    {0x3D, {"count_uint16", 1.0f, 2, false, ObjectKind::SENSOR}},
+    {0x3E, {"count_uint32", 1.0f, 4, false, ObjectKind::SENSOR}},
+    {0x3F, {"rotation", 0.1f, 2, true, ObjectKind::SENSOR}},
+    {0x40, {"distance_mm", 1.0f, 2, false, ObjectKind::SENSOR}},
+    {0x41, {"distance_m", 0.1f, 2, false, ObjectKind::SENSOR}},
+    {0x42, {"duration", 0.001f, 3, false, ObjectKind::SENSOR}},
+    {0x43, {"current", 0.001f, 2, false, ObjectKind::SENSOR}},
+    {0x44, {"speed", 0.01f, 2, false, ObjectKind::SENSOR}},
+    {0x45, {"temperature_01", 0.1f, 2, true, ObjectKind::SENSOR}},
+    {0x46, {"uv_index", 0.1f, 1, false, ObjectKind::SENSOR}},
+    {0x47, {"volume_l_01", 0.1f, 2, false, ObjectKind::SENSOR}},
+    {0x48, {"volume_ml", 1.0f, 2, false, ObjectKind::SENSOR}},
+    {0x49, {"volume_flow_rate", 0.001f, 2, false, ObjectKind::SENSOR}},
+    {0x4A, {"voltage_01", 0.1f, 2, false, ObjectKind::SENSOR}},
+    {0x4B, {"gas", 0.001f, 3, false, ObjectKind::SENSOR}},
+    {0x4C, {"gas_uint32", 0.001f, 4, false, ObjectKind::SENSOR}},
+    {0x4D, {"energy_uint32", 0.001f, 4, false, ObjectKind::SENSOR}},
+    {0x4E, {"volume_l", 0.001f, 4, false, ObjectKind::SENSOR}},
+    {0x4F, {"water", 0.001f, 4, false, ObjectKind::SENSOR}},
+    {0x50, {"timestamp", 1.0f, 4, false, ObjectKind::SENSOR}},
+    {0x51, {"acceleration", 0.001f, 2, false, ObjectKind::SENSOR}},
+    {0x52, {"gyroscope", 0.001f, 2, false, ObjectKind::SENSOR}},
+    {0x53, {"text", 1.0f, 0, false, ObjectKind::TEXT}},
+    {0x54, {"raw", 1.0f, 0, false, ObjectKind::RAW}},
+    {0x55, {"volume_storage", 0.001f, 4, false, ObjectKind::SENSOR}},
+    {0x56, {"conductivity", 1.0f, 2, false, ObjectKind::SENSOR}},
+    {0x57, {"temperature_sint8", 1.0f, 1, true, ObjectKind::SENSOR}},
+    {0x58, {"temperature_sint8_035", 0.35f, 1, true, ObjectKind::SENSOR}},
+    {0x59, {"count_sint8", 1.0f, 1, true, ObjectKind::SENSOR}},
+    {0x5A, {"count_sint16", 1.0f, 2, true, ObjectKind::SENSOR}},
+    {0x5B, {"count_sint32", 1.0f, 4, true, ObjectKind::SENSOR}},
+    {0x5C, {"power_sint32", 0.01f, 4, true, ObjectKind::SENSOR}},
+    {0x5D, {"current_sint16", 0.001f, 2, true, ObjectKind::SENSOR}},
+    {0x5E, {"direction", 0.01f, 2, false, ObjectKind::SENSOR}},
+    {0x5F, {"precipitation", 0.1f, 2, false, ObjectKind::SENSOR}},
+    {0x60, {"channel", 1.0f, 1, false, ObjectKind::SENSOR}},
+    {0x61, {"rotational_speed", 1.0f, 2, false, ObjectKind::SENSOR}},
+};
+
+// Flat lookup table indexed by object ID, built at compile time and placed in flash.
+// Undefined object IDs are zero-initialized (kind UNKNOWN, name nullptr).
+static constexpr std::array<ObjectTypeInfo, 256> build_object_type_table() {
+  std::array<ObjectTypeInfo, 256> table{};
+  for (const auto &entry : OBJECT_TYPE_ENTRIES) {
+    table[entry.object_id] = entry.info;
+  }
+  return table;
+}
+static constexpr std::array<ObjectTypeInfo, 256> OBJECT_TYPE_TABLE = build_object_type_table();
+
+const ObjectTypeInfo &get_object_type(uint8_t object_id) { return OBJECT_TYPE_TABLE[object_id]; }
+
+// ============================================================================
+// Decoding
+// ============================================================================
+
+ReadResult ObjectReader::next(Object &object) {
+  if (this->pos_ >= this->len_) {
+    return ReadResult::END;
+  }
+
+  object.offset = this->pos_;
+  object.object_id = this->data_[this->pos_++];
+  object.type = &OBJECT_TYPE_TABLE[object.object_id];
+
+  size_t value_len;
+  switch (object.type->kind) {
+    case ObjectKind::UNKNOWN:
+      return ReadResult::UNKNOWN_OBJECT;
+    case ObjectKind::TEXT:
+    case ObjectKind::RAW:
+      // Length-prefixed: object_id(1) + length(1) + data
+      if (this->pos_ + 1 > this->len_) {
+        return ReadResult::TRUNCATED;
+      }
+      value_len = this->data_[this->pos_++];
+      break;
+    default:
+      value_len = object.type->data_bytes;
+      break;
+  }
+
+  if (this->pos_ + value_len > this->len_) {
+    return ReadResult::TRUNCATED;
+  }
+
+  // Repeated object IDs are numbered in order of appearance (e.g. speed + gust, button 1 + button 2)
+  object.index = this->counts_[object.object_id]++;
+  object.data = this->data_ + this->pos_;
+  object.data_len = value_len;
+  this->pos_ += value_len;
+  return ReadResult::OK;
+}
+
+int32_t decode_raw_value(const ObjectTypeInfo &type_info, const uint8_t *data) {
+  // Little-endian integer of 1-4 bytes
+  uint32_t value = 0;
+  for (uint8_t i = 0; i < type_info.data_bytes; i++) {
+    value |= uint32_t(data[i]) << (8 * i);
+  }
+
+  if (type_info.is_signed && type_info.data_bytes < 4) {
+    // Sign-extend from data_bytes * 8 bits to 32 bits
+    uint32_t sign_bit = 1u << (8 * type_info.data_bytes - 1);
+    if (value & sign_bit) {
+      value |= ~((sign_bit << 1) - 1);
+    }
+  }
+  return static_cast<int32_t>(value);
+}
+
+// ============================================================================
+// Encoding
+// ============================================================================
+
+size_t encode_value(uint8_t *out, size_t max_len, uint8_t object_id, uint8_t data_bytes, bool is_signed, float factor,
+                    float value) {
+  if (data_bytes < 1 || data_bytes > 4) {
+    return 0;
+  }
+  size_t required_size = 1 + data_bytes;  // object_id + value bytes
+  if (max_len < required_size) {
+    return 0;
+  }
+
+  // Factor is the resolution (e.g. 0.01 means value * 100), so divide to get the encoded integer
+  double scaled = std::round(value / factor);
+
+  uint32_t encoded;
+  if (is_signed) {
+    double max_value = data_bytes == 4 ? 2147483647.0 : double((1u << (8 * data_bytes - 1)) - 1);
+    double min_value = -max_value - 1;
+    encoded = static_cast<uint32_t>(static_cast<int32_t>(std::fmax(min_value, std::fmin(max_value, scaled))));
+  } else {
+    double max_value = data_bytes == 4 ? 4294967295.0 : double((1u << (8 * data_bytes)) - 1);
+    encoded = static_cast<uint32_t>(std::fmax(0.0, std::fmin(max_value, scaled)));
+  }
+
+  out[0] = object_id;
+  for (uint8_t i = 0; i < data_bytes; i++) {
+    out[1 + i] = (encoded >> (8 * i)) & 0xFF;
+  }
+  return required_size;
+}
+
+size_t encode_binary(uint8_t *out, size_t max_len, uint8_t object_id, bool value) {
+  if (max_len < 2) {
+    return 0;
+  }
+  out[0] = object_id;
+  out[1] = value ? 0x01 : 0x00;
+  return 2;
+}
+
+size_t encode_event(uint8_t *out, size_t max_len, uint8_t object_id, const uint8_t *event_data,
+                    size_t event_data_len) {
+  size_t total_len = 1 + event_data_len;
+  if (max_len < total_len) {
+    return 0;
+  }
+  out[0] = object_id;
+  memcpy(out + 1, event_data, event_data_len);
+  return total_len;
+}
+
+// ============================================================================
+// Encryption framing
+// ============================================================================
+
+void build_nonce(uint8_t *nonce, const uint8_t *mac, uint8_t device_info, uint32_t counter) {
+  memcpy(nonce, mac, 6);
+  nonce[6] = BTHOME_SERVICE_UUID & 0xFF;         // 0xD2
+  nonce[7] = (BTHOME_SERVICE_UUID >> 8) & 0xFF;  // 0xFC
+  nonce[8] = device_info;
+  nonce[9] = counter & 0xFF;
+  nonce[10] = (counter >> 8) & 0xFF;
+  nonce[11] = (counter >> 16) & 0xFF;
+  nonce[12] = (counter >> 24) & 0xFF;
+}
+
+void mac_to_bytes(uint64_t address, uint8_t *mac) {
+  for (int i = 0; i < 6; i++) {
+    mac[i] = (address >> (8 * (5 - i))) & 0xFF;
+  }
+}
+
+bool split_encrypted_frame(const uint8_t *service_data, size_t len, EncryptedFrame &frame) {
+  if (len < 1 + COUNTER_SIZE + MIC_SIZE) {
+    return false;
+  }
+  frame.device_info = service_data[0];
+  frame.ciphertext = service_data + 1;
+  frame.ciphertext_len = len - 1 - COUNTER_SIZE - MIC_SIZE;
+  frame.counter = read_encrypted_counter(service_data, len);
+  frame.mic = service_data + len - MIC_SIZE;
+  return true;
+}
+
+size_t write_encrypted_trailer(uint8_t *out, size_t max_len, uint32_t counter, const uint8_t *mic) {
+  if (max_len < COUNTER_SIZE + MIC_SIZE) {
+    return 0;
+  }
+  out[0] = counter & 0xFF;
+  out[1] = (counter >> 8) & 0xFF;
+  out[2] = (counter >> 16) & 0xFF;
+  out[3] = (counter >> 24) & 0xFF;
+  memcpy(out + COUNTER_SIZE, mic, MIC_SIZE);
+  return COUNTER_SIZE + MIC_SIZE;
+}
+
+// ============================================================================
+// Advertisement scheduling
+// ============================================================================
+
+bool pack_frames(std::vector<ScheduleItem> items, size_t frame_count, size_t capacity,
+                 std::vector<std::vector<uint16_t>> &frames) {
+  auto appearances = [frame_count](const ScheduleItem &item) -> size_t {
+    if (item.period == 0 || item.period >= frame_count) {
+      return 1;
+    }
+    return (frame_count + item.period - 1) / item.period;
+  };
+  std::stable_sort(items.begin(), items.end(), [&appearances](const ScheduleItem &a, const ScheduleItem &b) {
+    size_t count_a = appearances(a);
+    size_t count_b = appearances(b);
+    return count_a != count_b ? count_a > count_b : a.size > b.size;
+  });
+
+  frames.assign(frame_count, {});
+  std::vector<size_t> used(frame_count, 0);
+  for (const ScheduleItem &item : items) {
+    size_t count = appearances(item);
+    bool placed = false;
+    for (size_t offset = 0; offset < frame_count && !placed; offset++) {
+      bool fits = true;
+      for (size_t j = 0; j < count && fits; j++) {
+        fits = used[(offset + j * frame_count / count) % frame_count] + item.size <= capacity;
+      }
+      if (!fits) {
+        continue;
+      }
+      for (size_t j = 0; j < count; j++) {
+        size_t frame = (offset + j * frame_count / count) % frame_count;
+        used[frame] += item.size;
+        frames[frame].push_back(item.id);
+      }
+      placed = true;
+    }
+    if (!placed) {
+      return false;
+    }
+  }
+  return true;
+}
+
+ScheduleResult build_schedule(std::vector<ScheduleItem> items, size_t capacity, size_t max_frames,
+                              std::vector<std::vector<uint16_t>> &frames) {
+  size_t total = 0;
+  for (const ScheduleItem &item : items) {
+    if (item.size > capacity) {
+      frames.assign(1, {});
+      return ScheduleResult::ITEM_TOO_LARGE;
+    }
+    total += item.size;
+  }
+
+  // Start from the fewest frames the bytes need and add frames until everything is placed
+  ScheduleResult result = ScheduleResult::OK;
+  const size_t min_frames = capacity > 0 ? std::max<size_t>(1, (total + capacity - 1) / capacity) : 1;
+  bool packed = false;
+  for (size_t count = min_frames; count <= max_frames && !packed; count++) {
+    packed = pack_frames(items, count, capacity, frames);
+  }
+  if (!packed) {
+    result = ScheduleResult::PERIODS_DROPPED;
+    for (auto &item : items) {
+      item.period = 0;
+    }
+    // Once per rotation always fits: at worst one frame per item
+    for (size_t count = min_frames; !pack_frames(items, count, capacity, frames); count++) {
+    }
+  }
+
+  // Configuration order within a frame
+  for (auto &frame : frames) {
+    std::sort(frame.begin(), frame.end());
+  }
+  return result;
+}
+
+}  // namespace bthome_codec
+}  // namespace esphome
@@ -0,0 +1,220 @@
+#pragma once
+
+// BTHome v2 codec shared by the bthome (sender) and bthome_receiver components.
+//
+// Pure protocol logic only: object type table, measurement encoding and decoding,
+// the framing around encrypted payloads, and the sender's rotation schedule. No ESPHome,
+// ESP-IDF or Zephyr headers, so it compiles on any host and is tested there (tests/).
+// AES-CCM itself stays in the components, which use the crypto library of their platform.
+//
+// Protocol specification: https://bthome.io/format/
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace esphome {
+namespace bthome_codec {
+
+// BTHome v2 constants
+static const uint16_t BTHOME_SERVICE_UUID = 0xFCD2;
+
+// Device info byte format: bit 0 = encryption, bit 2 = trigger-based, bits 5-7 = version (2)
+static const uint8_t BTHOME_DEVICE_INFO_ENCRYPTED_MASK = 0x01;
+static const uint8_t BTHOME_DEVICE_INFO_TRIGGER_MASK = 0x04;
+static const uint8_t BTHOME_DEVICE_INFO_UNENCRYPTED = 0x40;          // Regular device, no encryption
+static const uint8_t BTHOME_DEVICE_INFO_ENCRYPTED = 0x41;            // Regular device, encrypted
+static const uint8_t BTHOME_DEVICE_INFO_TRIGGER_UNENCRYPTED = 0x44;  // Trigger-based device, no encryption
+static const uint8_t BTHOME_DEVICE_INFO_TRIGGER_ENCRYPTED = 0x45;    // Trigger-based device, encrypted
+
+// Special object IDs
+static const uint8_t OBJECT_ID_PACKET_ID = 0x00;
+static const uint8_t OBJECT_ID_BUTTON = 0x3A;
+static const uint8_t OBJECT_ID_DIMMER = 0x3C;
+static const uint8_t OBJECT_ID_TEXT = 0x53;
+static const uint8_t OBJECT_ID_RAW = 0x54;
+
+// Button event types (BTHome v2 spec object ID 0x3A)
+static const uint8_t BUTTON_EVENT_NONE = 0x00;
+static const uint8_t BUTTON_EVENT_PRESS = 0x01;
+static const uint8_t BUTTON_EVENT_DOUBLE_PRESS = 0x02;
+static const uint8_t BUTTON_EVENT_TRIPLE_PRESS = 0x03;
+static const uint8_t BUTTON_EVENT_LONG_PRESS = 0x04;
+static const uint8_t BUTTON_EVENT_LONG_DOUBLE_PRESS = 0x05;
+static const uint8_t BUTTON_EVENT_LONG_TRIPLE_PRESS = 0x06;
+static const uint8_t BUTTON_EVENT_HOLD_PRESS = 0x80;
+
+// Encryption constants
+static const size_t AES_KEY_SIZE = 16;
+static const size_t NONCE_SIZE = 13;
+static const size_t COUNTER_SIZE = 4;
+static const size_t MIC_SIZE = 4;
+
+// How the payload of an object ID is decoded
+enum class ObjectKind : uint8_t {
+  UNKNOWN = 0,    // Not defined by BTHome v2 - size unknown, parsing must stop
+  SENSOR,         // Fixed-size integer scaled by factor
+  BINARY_SENSOR,  // Single byte, 0x00 = off
+  BUTTON,         // Single byte event type
+  DIMMER,         // Single signed byte step count
+  TEXT,           // Length-prefixed UTF-8 string
+  RAW,            // Length-prefixed bytes
+};
+
+// Object type info for encoding and decoding BTHome data
+struct ObjectTypeInfo {
+  const char *name;
+  float factor;
+  uint8_t data_bytes;
+  bool is_signed;
+  ObjectKind kind;
+};
+
+// Type info for an object ID; undefined IDs have kind UNKNOWN and a null name
+const ObjectTypeInfo &get_object_type(uint8_t object_id);
+
+// Name of an object type, "?" for undefined IDs
+inline const char *object_type_name(const ObjectTypeInfo &type_info) {
+  return type_info.name != nullptr ? type_info.name : "?";
+}
+
+// =============================================================================
+// Decoding
+// =============================================================================
+
+// One object located in a plaintext payload, not yet decoded
+struct Object {
+  uint8_t object_id;
+  uint8_t index;                 // Occurrence of this object ID within the payload (0 = first)
+  const ObjectTypeInfo *type;
+  const uint8_t *data;           // Value bytes; for text and raw, the bytes after the length prefix
+  uint8_t data_len;
+  size_t offset;                 // Offset of the object ID byte within the payload
+};
+
+enum class ReadResult : uint8_t {
+  OK,
+  END,             // Payload fully consumed
+  TRUNCATED,       // Object runs past the end of the payload
+  UNKNOWN_OBJECT,  // Object ID not defined by BTHome v2; its size is unknown so reading stops
+};
+
+// Walks the objects of a plaintext payload (after device_info, or after decryption).
+// Only frames the objects - values are decoded on demand with decode_value().
+class ObjectReader {
+ public:
+  ObjectReader(const uint8_t *data, size_t len) : data_(data), len_(len) {}
+
+  ReadResult next(Object &object);
+
+  size_t position() const { return this->pos_; }
+
+ protected:
+  const uint8_t *data_;
+  size_t len_;
+  size_t pos_{0};
+  std::array<uint8_t, 256> counts_{};
+};
+
+// Decode the little-endian integer of a SENSOR object (sign-extended when signed)
+int32_t decode_raw_value(const ObjectTypeInfo &type_info, const uint8_t *data);
+
+// Decode and scale the value of a SENSOR object
+inline float decode_value(const ObjectTypeInfo &type_info, const uint8_t *data) {
+  return decode_raw_value(type_info, data) * type_info.factor;
+}
+
+// =============================================================================
+// Encoding
+// =============================================================================
+
+// Encode a numeric measurement: [object_id][value, data_bytes little-endian].
+// The value is divided by factor, rounded and clamped to the integer range.
+// Returns the number of bytes written, 0 if it does not fit or data_bytes is invalid.
+size_t encode_value(uint8_t *out, size_t max_len, uint8_t object_id, uint8_t data_bytes, bool is_signed, float factor,
+                    float value);
+
+// Encode a binary measurement: [object_id][0x00 or 0x01]
+size_t encode_binary(uint8_t *out, size_t max_len, uint8_t object_id, bool value);
+
+// Encode an event: [object_id][event_data...]
+size_t encode_event(uint8_t *out, size_t max_len, uint8_t object_id, const uint8_t *event_data,
+                    size_t event_data_len);
+
+// =============================================================================
+// Encryption framing
+// Encrypted service data: device_info(1) + ciphertext + counter(4) + MIC(4)
+// =============================================================================
+
+// Build the AES-CCM nonce: MAC(6, as written MSB first) + UUID(2, little-endian) + device_info(1) + counter(4)
+void build_nonce(uint8_t *nonce, const uint8_t *mac, uint8_t device_info, uint32_t counter);
+
+// MAC address bytes MSB first from the 48-bit integer form (0xAABBCCDDEEFF -> AA BB CC DD EE FF)
+void mac_to_bytes(uint64_t address, uint8_t *mac);
+
+// Encrypted service data split into its parts (pointers into the original buffer)
+struct EncryptedFrame {
+  uint8_t device_info;
+  const uint8_t *ciphertext;
+  size_t ciphertext_len;
+  uint32_t counter;
+  const uint8_t *mic;
+};
+
+// Split encrypted service data; returns false if it is too short for counter and MIC
+bool split_encrypted_frame(const uint8_t *service_data, size_t len, EncryptedFrame &frame);
+
+// Read only the counter of encrypted service data (caller checks the length)
+inline uint32_t read_encrypted_counter(const uint8_t *service_data, size_t len) {
+  const uint8_t *counter = service_data + len - COUNTER_SIZE - MIC_SIZE;
+  return counter[0] | (counter[1] << 8) | (counter[2] << 16) | (uint32_t(counter[3]) << 24);
+}
+
+// Append counter and MIC after ciphertext already placed at out; returns bytes written (8),
+// or 0 if they do not fit in max_len
+size_t write_encrypted_trailer(uint8_t *out, size_t max_len, uint32_t counter, const uint8_t *mic);
+
+// =============================================================================
+// Advertisement scheduling (sender)
+// Measurements that do not fit one advertisement rotate through several frames
+// =============================================================================
+
+// Flags (3) + service data length, type and UUID (4) + device info (1) + packet ID object (2)
+static const size_t ADV_HEADER_SIZE = 10;
+// Counter (4) + MIC (4) appended to encrypted payloads
+static const size_t ENCRYPTION_OVERHEAD = COUNTER_SIZE + MIC_SIZE;
+
+// Bytes left for measurement objects in an advertisement of max_len bytes (0 if none)
+inline size_t payload_capacity(size_t max_len, bool encrypted) {
+  size_t overhead = ADV_HEADER_SIZE + (encrypted ? ENCRYPTION_OVERHEAD : 0);
+  return max_len > overhead ? max_len - overhead : 0;
+}
+
+// A measurement in the rotation schedule of periodic advertisements
+static const uint16_t SCHEDULE_BINARY = 0x8000;  // Set in ScheduleItem::id for binary sensors
+
+struct ScheduleItem {
+  uint16_t id;      // Index into the sender's measurements, or into its binary ones | SCHEDULE_BINARY
+  uint8_t size;     // Encoded size: object ID + value
+  uint16_t period;  // Must appear at least every this many frames (0 = once per rotation)
+};
+
+// Place every item in frame_count frames of capacity bytes, first-fit decreasing by how often an
+// item must appear, then by size. Returns false if they do not fit.
+bool pack_frames(std::vector<ScheduleItem> items, size_t frame_count, size_t capacity,
+                 std::vector<std::vector<uint16_t>> &frames);
+
+enum class ScheduleResult : uint8_t {
+  OK,
+  PERIODS_DROPPED,  // No frame count up to max_frames meets every period; each item appears once per rotation
+  ITEM_TOO_LARGE,   // An item does not fit in an empty frame; frames holds one empty frame
+};
+
+// Pack items into the fewest frames, up to max_frames, that meet every period. Each frame lists its
+// item IDs in ascending order.
+ScheduleResult build_schedule(std::vector<ScheduleItem> items, size_t capacity, size_t max_frames,
+                              std::vector<std::vector<uint16_t>> &frames);
+
+}  // namespace bthome_codec
+}  // namespace esphome
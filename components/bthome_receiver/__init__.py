@@ -24,7 +24,7 @@ from esphome.core import CORE
 from esphome.components.esp32 import add_idf_sdkconfig_option
 
 CODEOWNERS = ["@esphome/core"]
-AUTO_LOAD = ["sensor", "binary_sensor", "text_sensor"]
+AUTO_LOAD = ["bthome_codec", "sensor", "binary_sensor", "text_sensor"]
 
 # BLE stack options
 CONF_BLE_STACK = "ble_stack"
@@ -39,15 +39,40 @@ CONF_EVENT = "event"
 CONF_BUTTON_INDEX = "button_index"
 CONF_DIMMER_INDEX = "dimmer_index"
 CONF_DUMP_INTERVAL = "dump_interval"
+CONF_STATS_INTERVAL = "stats_interval"
+CONF_BATCH_PUBLISH = "batch_publish"
+CONF_REPLAY_PROTECTION = "replay_protection"
+CONF_RESYNC = "resync"
+CONF_RESYNC_PACKETS = "resync_packets"
+CONF_PERSIST_INTERVAL = "persist_interval"
+CONF_QUEUE_SIZE = "queue_size"
+CONF_DETECTED_CACHE_SIZE = "detected_cache_size"
+CONF_SCAN_PARAMETERS = "scan_parameters"
+CONF_FILTER_ACCEPT_LIST = "filter_accept_list"
+CONF_PRESET = "preset"
+CONF_INTERVAL = "interval"
+CONF_WINDOW = "window"
+CONF_ADAPTIVE = "adaptive"
+CONF_OVERDUE_TIMEOUT = "overdue_timeout"
+
+# Scan presets: (interval_ms, window_ms)
+SCAN_PRESETS = {
+    "continuous": (100, 100),
+    "balanced": (100, 50),
+    "low_power": (300, 30),
+}
 
 bthome_receiver_ns = cg.esphome_ns.namespace("bthome_receiver")
 # Note: BTHomeReceiverHub class definition depends on BLE stack at runtime
 # For Bluedroid it inherits from ESPBTDeviceListener, for NimBLE it's standalone
 BTHomeReceiverHub = bthome_receiver_ns.class_("BTHomeReceiverHub", cg.Component)
 BTHomeDevice = bthome_receiver_ns.class_("BTHomeDevice", cg.Parented.template(BTHomeReceiverHub))
-BTHomeSensor = bthome_receiver_ns.class_("BTHomeSensor")
-BTHomeBinarySensor = bthome_receiver_ns.class_("BTHomeBinarySensor")
-BTHomeTextSensor = bthome_receiver_ns.class_("BTHomeTextSensor")
+ResyncPolicy = BTHomeDevice.enum("ResyncPolicy", True)
+RESYNC_POLICIES = {
+    "strict": ResyncPolicy.STRICT,
+    "consecutive": ResyncPolicy.CONSECUTIVE,
+    "immediate": ResyncPolicy.IMMEDIATE,
+}
 
 # Event triggers
 BTHomeButtonTrigger = bthome_receiver_ns.class_(
@@ -61,6 +86,9 @@ BTHomeDimmerTrigger = bthome_receiver_ns.class_(
     "BTHomeDimmerTrigger", automation.Trigger.template(int8_t)
 )
 
+# Actions
+ClearCounterAction = bthome_receiver_ns.class_("ClearCounterAction", automation.Action)
+
 # =============================================================================
 # BTHome v2 Sensor Object IDs - same as broadcaster component
 # Format: "type_name": (object_id, data_bytes, signed, factor)
@@ -201,6 +229,49 @@ DIMMER_TRIGGER_SCHEMA = automation.validate_automation(
     }
 )
 
+def validate_scan_parameters(config):
+    """Resolve the preset and check interval/window against the BLE limits."""
+    interval, window = SCAN_PRESETS[config[CONF_PRESET]]
+    interval = config.get(CONF_INTERVAL, cv.TimePeriod(milliseconds=interval)).total_milliseconds
+    window = config.get(CONF_WINDOW, cv.TimePeriod(milliseconds=window)).total_milliseconds
+    if window > interval:
+        raise cv.Invalid(f"Scan window ({window}ms) must not be longer than the interval ({interval}ms)")
+    config[CONF_INTERVAL] = cv.TimePeriod(milliseconds=interval)
+    config[CONF_WINDOW] = cv.TimePeriod(milliseconds=window)
+    return config
+
+
+SCAN_PARAMETERS_SCHEMA = cv.All(
+    cv.Schema(
+        {
+            cv.Optional(CONF_PRESET, default="balanced"): cv.one_of(*SCAN_PRESETS.keys(), lower=True),
+            # BLE scan timing range: 2.5ms to 10.24s in 0.625ms steps
+            cv.Optional(CONF_INTERVAL): cv.All(
+                cv.positive_time_period_milliseconds,
+                cv.Range(min=cv.TimePeriod(microseconds=2500), max=cv.TimePeriod(microseconds=10240000)),
+            ),
+            cv.Optional(CONF_WINDOW): cv.All(
+                cv.positive_time_period_milliseconds,
+                cv.Range(min=cv.TimePeriod(microseconds=2500), max=cv.TimePeriod(microseconds=10240000)),
+            ),
+            # Widen the window while a registered device is overdue
+            cv.Optional(CONF_ADAPTIVE, default=False): cv.boolean,
+            cv.Optional(CONF_OVERDUE_TIMEOUT, default="60s"): cv.positive_time_period_milliseconds,
+        }
+    ),
+    validate_scan_parameters,
+)
+
+REPLAY_PROTECTION_SCHEMA = cv.Schema(
+    {
+        # What to do when a device's counter jumps back below the replay window (sender reboot)
+        cv.Optional(CONF_RESYNC, default="consecutive"): cv.enum(RESYNC_POLICIES, lower=True),
+        cv.Optional(CONF_RESYNC_PACKETS, default=3): cv.int_range(min=2, max=255),
+        # Save changed counters to flash at most this often; 0s disables persistence
+        cv.Optional(CONF_PERSIST_INTERVAL, default="5min"): cv.positive_time_period_milliseconds,
+    }
+)
+
 DEVICE_SCHEMA = cv.Schema(
     {
         cv.GenerateID(): cv.declare_id(BTHomeDevice),
@@ -230,6 +301,20 @@ _BASE_SCHEMA = cv.Schema(
         ),
         # Interval for periodic dump of all detected devices (0 = disabled)
         cv.Optional(CONF_DUMP_INTERVAL): cv.positive_time_period_milliseconds,
+        # Publish decoded values once per loop() and skip unchanged ones
+        cv.Optional(CONF_BATCH_PUBLISH, default=False): cv.boolean,
+        # Encrypted devices: replay window resync and counter persistence
+        cv.Optional(CONF_REPLAY_PROTECTION, default={}): REPLAY_PROTECTION_SCHEMA,
+        # Interval for publishing reception statistics sensors
+        cv.Optional(CONF_STATS_INTERVAL, default="60s"): cv.positive_time_period_milliseconds,
+        # Devices remembered for the periodic dump; least recently seen are evicted
+        cv.Optional(CONF_DETECTED_CACHE_SIZE, default=64): cv.int_range(min=1, max=1024),
+        # NimBLE only: advertisements buffered between the BLE host task and loop()
+        cv.Optional(CONF_QUEUE_SIZE, default=32): cv.int_range(min=4, max=256),
+        # NimBLE only: scan interval/window (Bluedroid scans via esp32_ble_tracker)
+        cv.Optional(CONF_SCAN_PARAMETERS): SCAN_PARAMETERS_SCHEMA,
+        # NimBLE only: let the controller drop advertisements from unregistered addresses
+        cv.Optional(CONF_FILTER_ACCEPT_LIST, default=False): cv.boolean,
     }
 ).extend(cv.COMPONENT_SCHEMA)
 
@@ -241,6 +326,15 @@ def _final_validate(config):
     if ble_stack == BLE_STACK_NIMBLE:
         if CORE.using_arduino:
             raise cv.Invalid("NimBLE BLE stack requires ESP-IDF framework, not Arduino")
+        if config[CONF_FILTER_ACCEPT_LIST] and not config[CONF_DEVICES]:
+            raise cv.Invalid("filter_accept_list requires at least one entry in devices")
+    elif config.get(CONF_FILTER_ACCEPT_LIST):
+        raise cv.Invalid("filter_accept_list only applies to the NimBLE stack")
+    elif CONF_SCAN_PARAMETERS in config:
+        raise cv.Invalid(
+            "scan_parameters only applies to the NimBLE stack; "
+            "configure Bluedroid scanning with esp32_ble_tracker scan_parameters"
+        )
     return config
 
 
@@ -258,12 +352,37 @@ async def to_code(config):
     # Set dump interval for periodic summary (0 = disabled)
     if CONF_DUMP_INTERVAL in config:
         cg.add(var.set_dump_interval(config[CONF_DUMP_INTERVAL]))
+        cg.add_define("BTHOME_RECEIVER_DETECTED_CACHE_SIZE", config[CONF_DETECTED_CACHE_SIZE])
+    else:
+        # Cache is only filled in discovery mode; keep a single slot so it costs no RAM
+        cg.add_define("BTHOME_RECEIVER_DETECTED_CACHE_SIZE", 1)
+
+    cg.add(var.set_stats_interval(config[CONF_STATS_INTERVAL]))
+    if config[CONF_BATCH_PUBLISH]:
+        cg.add(var.set_batch_publish(True))
+
+    replay = config[CONF_REPLAY_PROTECTION]
+    cg.add(var.set_resync_policy(replay[CONF_RESYNC], replay[CONF_RESYNC_PACKETS]))
+    cg.add(var.set_counter_persist_interval(replay[CONF_PERSIST_INTERVAL]))
 
     ble_stack = config.get(CONF_BLE_STACK, BLE_STACK_BLUEDROID)
 
     if ble_stack == BLE_STACK_NIMBLE:
         # NimBLE stack configuration
         cg.add_define("USE_BTHOME_RECEIVER_NIMBLE")
+        cg.add_define("BTHOME_RECEIVER_QUEUE_SIZE", config[CONF_QUEUE_SIZE])
+
+        if CONF_SCAN_PARAMETERS in config:
+            scan = config[CONF_SCAN_PARAMETERS]
+            # BLE scan timing is in 0.625ms units
+            interval = int(round(scan[CONF_INTERVAL].total_milliseconds / 0.625))
+            window = int(round(scan[CONF_WINDOW].total_milliseconds / 0.625))
+            cg.add(var.set_scan_parameters(interval, window))
+            if scan[CONF_ADAPTIVE]:
+                cg.add(var.set_scan_adaptive(scan[CONF_OVERDUE_TIMEOUT]))
+
+        if config[CONF_FILTER_ACCEPT_LIST]:
+            cg.add(var.set_filter_accept_list(True))
 
         # Enable NimBLE in ESP-IDF
         add_idf_sdkconfig_option("CONFIG_BT_ENABLED", True)
@@ -340,3 +459,23 @@ async def to_code(config):
             await automation.build_automation(trigger, [(int8, "steps")], dimmer_conf)
 
         cg.add(var.register_device(device_var))
+
+
+# =============================================================================
+# Action for clearing a device's stored encryption counter
+# =============================================================================
+
+CLEAR_COUNTER_ACTION_SCHEMA = automation.maybe_simple_id(
+    {
+        cv.Required(CONF_ID): cv.use_id(BTHomeDevice),
+    }
+)
+
+
+@automation.register_action(
+    "bthome_receiver.clear_counter", ClearCounterAction, CLEAR_COUNTER_ACTION_SCHEMA
+)
+async def clear_counter_to_code(config, action_id, template_arg, args):
+    var = cg.new_Pvariable(action_id, template_arg)
+    await cg.register_parented(var, config[CONF_ID])
+    return var
@@ -15,7 +15,6 @@ from esphome.const import (
 
 from . import (
     BINARY_SENSOR_TYPES,
-    BTHomeBinarySensor,
     BTHomeDevice,
     BTHomeReceiverHub,
     CONF_ENCRYPTION_KEY,
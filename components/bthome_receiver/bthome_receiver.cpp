@@ -1,7 +1,7 @@
 #include "bthome_receiver.h"
 #include "esphome/core/log.h"
-#include "mbedtls/ccm.h"
 
+#include <algorithm>
 #include <cstring>
 #include <cmath>
 
@@ -17,195 +17,44 @@ static const char *const TAG = "bthome_receiver";
 #ifdef USE_BTHOME_RECEIVER_NIMBLE
 // Static instance pointer for NimBLE callbacks
 BTHomeReceiverHub *BTHomeReceiverHub::instance_ = nullptr;
+
+// Minimum time between advertisement queue overflow warnings
+static const uint32_t QUEUE_DROP_LOG_INTERVAL_MS = 10000;
+
+// Delay after setup() before NimBLE is initialized, so other components are ready
+static const uint32_t NIMBLE_INIT_DELAY_MS = 2000;
+// Tick of the scan scheduler timer
+static const uint32_t SCAN_SCHEDULER_TICK_MS = 1000;
+// How often the adaptive scan scheduler re-evaluates device freshness
+static const uint32_t SCAN_ADAPT_INTERVAL_MS = 5000;
+// A device silent for this many overdue timeouts is considered gone and no longer widens the window
+static const uint32_t SCAN_OVERDUE_GIVE_UP_FACTOR = 10;
+// Period over which scan duty cycle and advertisement rate are measured
+static const uint32_t SCAN_STATS_INTERVAL_MS = 10000;
 #endif
 
-// BTHome v2 object type lookup table
-// Format: object_id -> (data_bytes, is_signed, factor, is_sensor, is_binary_sensor)
-static const std::map<uint8_t, ObjectTypeInfo> OBJECT_TYPE_MAP = {
-    // Basic sensors
-    {0x00, {1, false, 1, true, false}},           // packet_id
-    {0x01, {1, false, 1, true, false}},           // battery
-    {0x02, {2, true, 0.01, true, false}},         // temperature
-    {0x03, {2, false, 0.01, true, false}},        // humidity
-    {0x04, {3, false, 0.01, true, false}},        // pressure
-    {0x05, {3, false, 0.01, true, false}},        // illuminance
-    {0x06, {2, false, 0.01, true, false}},        // mass_kg
-    {0x07, {2, false, 0.01, true, false}},        // mass_lb
-    {0x08, {2, true, 0.01, true, false}},         // dewpoint
-    {0x09, {1, false, 1, true, false}},           // count_uint8
-    {0x0A, {3, false, 0.001, true, false}},       // energy
-    {0x0B, {3, false, 0.01, true, false}},        // power
-    {0x0C, {2, false, 0.001, true, false}},       // voltage
-    {0x0D, {2, false, 1, true, false}},           // pm2_5
-    {0x0E, {2, false, 1, true, false}},           // pm10
-    {0x12, {2, false, 1, true, false}},           // co2
-    {0x13, {2, false, 1, true, false}},           // tvoc
-    {0x14, {2, false, 0.01, true, false}},        // moisture
-    {0x2E, {1, false, 1, true, false}},           // humidity_uint8
-    {0x2F, {1, false, 1, true, false}},           // moisture_uint8
-
-    // Binary sensors
-    {0x0F, {1, false, 1, false, true}},           // generic_boolean
-    {0x10, {1, false, 1, false, true}},           // power
-    {0x11, {1, false, 1, false, true}},           // opening
-    {0x15, {1, false, 1, false, true}},           // battery_low
-    {0x16, {1, false, 1, false, true}},           // battery_charging
-    {0x17, {1, false, 1, false, true}},           // carbon_monoxide
-    {0x18, {1, false, 1, false, true}},           // cold
-    {0x19, {1, false, 1, false, true}},           // connectivity
-    {0x1A, {1, false, 1, false, true}},           // door
-    {0x1B, {1, false, 1, false, true}},           // garage_door
-    {0x1C, {1, false, 1, false, true}},           // gas
-    {0x1D, {1, false, 1, false, true}},           // heat
-    {0x1E, {1, false, 1, false, true}},           // light
-    {0x1F, {1, false, 1, false, true}},           // lock
-    {0x20, {1, false, 1, false, true}},           // moisture_binary
-    {0x21, {1, false, 1, false, true}},           // motion
-    {0x22, {1, false, 1, false, true}},           // moving
-    {0x23, {1, false, 1, false, true}},           // occupancy
-    {0x24, {1, false, 1, false, true}},           // plug
-    {0x25, {1, false, 1, false, true}},           // presence
-    {0x26, {1, false, 1, false, true}},           // problem
-    {0x27, {1, false, 1, false, true}},           // running
-    {0x28, {1, false, 1, false, true}},           // safety
-    {0x29, {1, false, 1, false, true}},           // smoke
-    {0x2A, {1, false, 1, false, true}},           // sound
-    {0x2B, {1, false, 1, false, true}},           // tamper
-    {0x2C, {1, false, 1, false, true}},           // vibration
-    {0x2D, {1, false, 1, false, true}},           // window
-
-    // Extended sensors
-    {0x3D, {2, false, 1, true, false}},           // count_uint16
-    {0x3E, {4, false, 1, true, false}},           // count_uint32
-    {0x3F, {2, true, 0.1, true, false}},          // rotation
-    {0x40, {2, false, 1, true, false}},           // distance_mm
-    {0x41, {2, false, 0.1, true, false}},         // distance_m
-    {0x42, {3, false, 0.001, true, false}},       // duration
-    {0x43, {2, false, 0.001, true, false}},       // current
-    {0x44, {2, false, 0.01, true, false}},        // speed
-    {0x45, {2, true, 0.1, true, false}},          // temperature_01
-    {0x46, {1, false, 0.1, true, false}},         // uv_index
-    {0x47, {2, false, 0.1, true, false}},         // volume_l_01
-    {0x48, {2, false, 1, true, false}},           // volume_ml
-    {0x49, {2, false, 0.001, true, false}},       // volume_flow_rate
-    {0x4A, {2, false, 0.1, true, false}},         // voltage_01
-    {0x4B, {3, false, 0.001, true, false}},       // gas
-    {0x4C, {4, false, 0.001, true, false}},       // gas_uint32
-    {0x4D, {4, false, 0.001, true, false}},       // energy_uint32
-    {0x4E, {4, false, 0.001, true, false}},       // volume_l
-    {0x4F, {4, false, 0.001, true, false}},       // water
-    {0x50, {4, false, 1, true, false}},           // timestamp
-    {0x51, {2, false, 0.001, true, false}},       // acceleration
-    {0x52, {2, false, 0.001, true, false}},       // gyroscope
-    {0x55, {4, false, 0.001, true, false}},       // volume_storage
-    {0x56, {2, false, 1, true, false}},           // conductivity
-    {0x57, {1, true, 1, true, false}},            // temperature_sint8
-    {0x58, {1, true, 0.35, true, false}},         // temperature_sint8_035
-    {0x59, {1, true, 1, true, false}},            // count_sint8
-    {0x5A, {2, true, 1, true, false}},            // count_sint16
-    {0x5B, {4, true, 1, true, false}},            // count_sint32
-    {0x5C, {4, true, 0.01, true, false}},         // power_sint32
-    {0x5D, {2, true, 0.001, true, false}},        // current_sint16
-    {0x5E, {2, false, 0.01, true, false}},        // direction
-    {0x5F, {2, false, 0.1, true, false}},         // precipitation
-    {0x60, {1, false, 1, true, false}},           // channel
-    {0x61, {2, false, 1, true, false}},           // rotational_speed
-};
-
-// Object ID to human-readable name mapping (for dump mode)
-static const std::map<uint8_t, const char *> OBJECT_ID_NAMES = {
-    // Sensors
-    {0x00, "packet_id"},
-    {0x01, "battery"},
-    {0x02, "temperature"},
-    {0x03, "humidity"},
-    {0x04, "pressure"},
-    {0x05, "illuminance"},
-    {0x06, "mass_kg"},
-    {0x07, "mass_lb"},
-    {0x08, "dewpoint"},
-    {0x09, "count"},
-    {0x0A, "energy"},
-    {0x0B, "power"},
-    {0x0C, "voltage"},
-    {0x0D, "pm2_5"},
-    {0x0E, "pm10"},
-    {0x12, "co2"},
-    {0x13, "tvoc"},
-    {0x14, "moisture"},
-    {0x2E, "humidity_uint8"},
-    {0x2F, "moisture_uint8"},
-    // Binary sensors
-    {0x0F, "generic_boolean"},
-    {0x10, "power_binary"},
-    {0x11, "opening"},
-    {0x15, "battery_low"},
-    {0x16, "battery_charging"},
-    {0x17, "carbon_monoxide"},
-    {0x18, "cold"},
-    {0x19, "connectivity"},
-    {0x1A, "door"},
-    {0x1B, "garage_door"},
-    {0x1C, "gas"},
-    {0x1D, "heat"},
-    {0x1E, "light"},
-    {0x1F, "lock"},
-    {0x20, "moisture_binary"},
-    {0x21, "motion"},
-    {0x22, "moving"},
-    {0x23, "occupancy"},
-    {0x24, "plug"},
-    {0x25, "presence"},
-    {0x26, "problem"},
-    {0x27, "running"},
-    {0x28, "safety"},
-    {0x29, "smoke"},
-    {0x2A, "sound"},
-    {0x2B, "tamper"},
-    {0x2C, "vibration"},
-    {0x2D, "window"},
-    // Events
-    {0x3A, "button"},
-    {0x3C, "dimmer"},
-    // Extended sensors
-    {0x3D, "count_uint16"},
-    {0x3E, "count_uint32"},
-    {0x3F, "rotation"},
-    {0x40, "distance_mm"},
-    {0x41, "distance_m"},
-    {0x42, "duration"},
-    {0x43, "current"},
-    {0x44, "speed"},
-    {0x45, "temperature_01"},
-    {0x46, "uv_index"},
-    {0x47, "volume_l_01"},
-    {0x48, "volume_ml"},
-    {0x49, "volume_flow_rate"},
-    {0x4A, "voltage_01"},
-    {0x4B, "gas"},
-    {0x4C, "gas_uint32"},
-    {0x4D, "energy_uint32"},
-    {0x4E, "volume_l"},
-    {0x4F, "water"},
-    {0x50, "timestamp"},
-    {0x51, "acceleration"},
-    {0x52, "gyroscope"},
-    {0x53, "text"},
-    {0x54, "raw"},
-    {0x55, "volume_storage"},
-    {0x56, "conductivity"},
-    {0x57, "temperature_sint8"},
-    {0x58, "temperature_sint8_035"},
-    {0x59, "count_sint8"},
-    {0x5A, "count_sint16"},
-    {0x5B, "count_sint32"},
-    {0x5C, "power_sint32"},
-    {0x5D, "current_sint16"},
-    {0x5E, "direction"},
-    {0x5F, "precipitation"},
-    {0x60, "channel"},
-    {0x61, "rotational_speed"},
-};
+// Size of the stack buffer used to format one discovery log line
+static const size_t DUMP_LINE_SIZE = 256;
+
+static const char HEX_DIGITS[] = "0123456789ABCDEF";
+
+// Append bytes as space-separated hex ("0A 1B 2C") at pos, keeping the buffer NUL-terminated.
+// Stops at the last byte that fits. Returns the new end position.
+static size_t append_hex(char *buf, size_t size, size_t pos, const uint8_t *data, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    size_t needed = (i > 0 ? 3 : 2);
+    if (pos + needed >= size) {
+      break;
+    }
+    if (i > 0) {
+      buf[pos++] = ' ';
+    }
+    buf[pos++] = HEX_DIGITS[data[i] >> 4];
+    buf[pos++] = HEX_DIGITS[data[i] & 0x0F];
+  }
+  buf[pos] = '\0';
+  return pos;
+}
 
 // ============================================================================
 // BTHomeReceiverHub Implementation
@@ -214,16 +63,52 @@ static const std::map<uint8_t, const char *> OBJECT_ID_NAMES = {
 void BTHomeReceiverHub::setup() {
   ESP_LOGCONFIG(TAG, "Setting up BTHome Receiver...");
 
+  for (auto *device : this->devices_) {
+    device->set_resync_policy(this->resync_policy_, this->resync_packets_);
+    if (this->counter_persist_interval_ > 0 && device->is_encryption_enabled()) {
+      device->load_counter();
+    }
+  }
+
+  // Periodic work runs from scheduler timers; loop() only runs while there is data to process
+#ifdef USE_SENSOR
+  if (this->stats_interval_ > 0) {
+    // Reception statistics sensors, and expiry of sensor histories whose device went quiet
+    this->set_interval("stats", this->stats_interval_, [this]() {
+      uint32_t now = esp_timer_get_time() / 1000;
+      for (auto *device : this->devices_) {
+        device->publish_stat_sensors(now);
+        device->expire_histories(now);
+      }
+    });
+  }
+#endif
+  if (this->counter_persist_interval_ > 0) {
+    // Bounded-rate persistence of encryption counters
+    this->set_interval("counter_persist", this->counter_persist_interval_, [this]() { this->persist_counters_(); });
+  }
+  if (this->dump_interval_ > 0) {
+    this->set_interval("dump", this->dump_interval_, [this]() { this->dump_all_devices_(); });
+  }
+
 #ifdef USE_BTHOME_RECEIVER_NIMBLE
   instance_ = this;
-  // Defer actual BLE initialization to loop() to ensure all other components are ready
+  // Defer actual BLE initialization to ensure all other components are ready
   this->nimble_initialized_ = false;
-  this->init_attempted_ = false;
-  ESP_LOGI(TAG, "BTHome Receiver configured, BLE init deferred to loop");
+  this->set_timeout("nimble_init", NIMBLE_INIT_DELAY_MS, [this]() { this->init_nimble_(); });
+  this->set_interval("scan_scheduler", SCAN_SCHEDULER_TICK_MS, [this]() {
+    if (this->nimble_initialized_) {
+      this->update_scan_scheduler_(esp_timer_get_time() / 1000);
+    }
+  });
+  ESP_LOGI(TAG, "BTHome Receiver configured, BLE init deferred");
 #else
   // Bluedroid setup is handled by esp32_ble_tracker
   ESP_LOGI(TAG, "Bluedroid receiver initialized");
 #endif
+
+  // Woken by queued advertisements and deferred publishes
+  this->disable_loop();
 }
 
 #ifdef USE_BTHOME_RECEIVER_NIMBLE
@@ -276,6 +161,7 @@ void BTHomeReceiverHub::init_nimble_() {
   nimble_sync_semaphore_ = nullptr;
 
   this->nimble_initialized_ = true;
+  this->start_scanning_();
   ESP_LOGI(TAG, "NimBLE receiver initialized successfully");
 }
 #endif
@@ -288,6 +174,23 @@ void BTHomeReceiverHub::dump_config() {
   ESP_LOGCONFIG(TAG, "  BLE Stack: Bluedroid");
 #endif
   ESP_LOGCONFIG(TAG, "  Dump Interval: %ums", this->dump_interval_);
+  ESP_LOGCONFIG(TAG, "  Detected Cache Size: %u", (unsigned) this->detected_devices_.capacity());
+  static const char *const RESYNC_POLICY_NAMES[] = {"strict", "consecutive", "immediate"};
+  ESP_LOGCONFIG(TAG, "  Replay Resync: %s (%u packets), Counter Persist Interval: %ums",
+                RESYNC_POLICY_NAMES[static_cast<size_t>(this->resync_policy_)], this->resync_packets_,
+                this->counter_persist_interval_);
+#ifdef USE_BTHOME_RECEIVER_NIMBLE
+  ESP_LOGCONFIG(TAG, "  Queue Size: %u", (unsigned) this->adv_queue_.capacity());
+  ESP_LOGCONFIG(TAG, "  Scan Interval: %.1fms, Window: %.1fms", this->scan_interval_ * 0.625f,
+                this->scan_window_base_ * 0.625f);
+  if (this->scan_adaptive_) {
+    ESP_LOGCONFIG(TAG, "  Adaptive Scan: device overdue after %ums", this->scan_overdue_timeout_);
+  }
+  if (this->filter_accept_list_) {
+    ESP_LOGCONFIG(TAG, "  Filter Accept List: %s",
+                  this->dump_interval_ > 0 ? "disabled while dump_interval is set" : "enabled");
+  }
+#endif
   ESP_LOGCONFIG(TAG, "  Registered Devices: %zu", this->devices_.size());
   for (auto *device : this->devices_) {
     uint64_t addr = device->get_mac_address();
@@ -299,6 +202,10 @@ void BTHomeReceiverHub::dump_config() {
 }
 
 void BTHomeReceiverHub::dump_advertisement_(uint64_t address, const uint8_t *data, size_t len) {
+  if (len < 1) {
+    return;
+  }
+
   // Format MAC address in standard format (MSB first, matches ESPHome config format)
   char mac_str[18];
   snprintf(mac_str, sizeof(mac_str), "%02X:%02X:%02X:%02X:%02X:%02X",
@@ -309,184 +216,253 @@ void BTHomeReceiverHub::dump_advertisement_(uint64_t address, const uint8_t *dat
            (uint8_t)((address >> 8) & 0xFF),
            (uint8_t)(address & 0xFF));
 
-  if (len < 1) {
-    return;
-  }
-
-  // Build raw hex string
-  std::string raw_hex;
-  for (size_t i = 0; i < len; i++) {
-    char hex[4];
-    snprintf(hex, sizeof(hex), "%02X ", data[i]);
-    raw_hex += hex;
-  }
-
   // First byte is device_info
   uint8_t device_info = data[0];
   bool is_encrypted = (device_info & BTHOME_DEVICE_INFO_ENCRYPTED_MASK) != 0;
 
-  // Build measurements string
-  std::string measurements;
-  size_t pos = 1;  // Skip device_info
-
-  while (pos < len) {
-    if (pos + 1 > len) break;
-
-    uint8_t object_id = data[pos++];
-
-    // Get human-readable name
-    const char *name = "?";
-    auto name_it = OBJECT_ID_NAMES.find(object_id);
-    if (name_it != OBJECT_ID_NAMES.end()) {
-      name = name_it->second;
-    }
+  // Everything is formatted into one stack buffer; output is truncated if it does not fit
+  char line[DUMP_LINE_SIZE];
+  size_t pos = 0;
+  line[0] = '\0';
 
-    // Handle special types
-    if (object_id == OBJECT_ID_BUTTON) {
-      if (pos + 1 > len) break;
-      uint8_t event_type = data[pos++];
-      char val_str[32];
-      snprintf(val_str, sizeof(val_str), "%s=0x%02X", name, event_type);
-      if (!measurements.empty()) measurements += " ";
-      measurements += val_str;
-      continue;
-    }
-    
-    if (object_id == OBJECT_ID_DIMMER) {
-      if (pos + 1 > len) break;
-      int8_t steps = static_cast<int8_t>(data[pos++]);
-      char val_str[32];
-      snprintf(val_str, sizeof(val_str), "%s=%d", name, steps);
-      if (!measurements.empty()) measurements += " ";
-      measurements += val_str;
-      continue;
-    }
+  if (is_encrypted) {
+    // Payload cannot be decoded without the key, show it as hex
+    pos = append_hex(line, sizeof(line), pos, data + 1, len - 1);
+    ESP_LOGI(TAG, "[%s] ENC | %s", mac_str, line);
+    return;
+  }
 
-    if (object_id == OBJECT_ID_TEXT || object_id == OBJECT_ID_RAW) {
-      if (pos + 1 > len) break;
-      uint8_t str_len = data[pos++];
-      if (pos + str_len > len) break;
-      pos += str_len;
-      continue;
+  bthome_codec::ObjectReader reader(data + 1, len - 1);
+  bthome_codec::Object object;
+  while (reader.next(object) == bthome_codec::ReadResult::OK) {
+    const ObjectTypeInfo &type_info = *object.type;
+    const char *name = bthome_codec::object_type_name(type_info);
+    const char *separator = pos > 0 ? " " : "";
+    size_t avail = sizeof(line) - pos;
+    int written;
+
+    switch (type_info.kind) {
+      case ObjectKind::BUTTON:
+        written = snprintf(line + pos, avail, "%s%s=0x%02X", separator, name, object.data[0]);
+        break;
+      case ObjectKind::DIMMER:
+        written = snprintf(line + pos, avail, "%s%s=%d", separator, name, static_cast<int8_t>(object.data[0]));
+        break;
+      case ObjectKind::BINARY_SENSOR:
+        written = snprintf(line + pos, avail, "%s%s=%s", separator, name, object.data[0] ? "ON" : "OFF");
+        break;
+      case ObjectKind::TEXT:
+        written = snprintf(line + pos, avail, "%s%s=\"%.*s\"", separator, name, object.data_len,
+                           reinterpret_cast<const char *>(object.data));
+        break;
+      case ObjectKind::RAW:
+        written = snprintf(line + pos, avail, "%s%s=", separator, name);
+        if (written > 0 && (size_t) written < avail) {
+          pos = append_hex(line, sizeof(line), pos + written, object.data, object.data_len);
+          continue;
+        }
+        break;
+      default:
+        written = snprintf(line + pos, avail, "%s%s=%.2f", separator, name,
+                           bthome_codec::decode_value(type_info, object.data));
+        break;
     }
 
-    auto it = OBJECT_TYPE_MAP.find(object_id);
-    if (it == OBJECT_TYPE_MAP.end()) break;
-
-    const ObjectTypeInfo &type_info = it->second;
-    if (pos + type_info.data_bytes > len) break;
-
-    char val_str[32];
-    if (type_info.is_binary_sensor) {
-      snprintf(val_str, sizeof(val_str), "%s=%s", name, data[pos] ? "ON" : "OFF");
-    } else {
-      int32_t raw_value = 0;
-      if (type_info.is_signed) {
-        switch (type_info.data_bytes) {
-          case 1: raw_value = static_cast<int8_t>(data[pos]); break;
-          case 2: raw_value = static_cast<int16_t>(data[pos] | (data[pos + 1] << 8)); break;
-          case 3:
-            raw_value = data[pos] | (data[pos + 1] << 8) | (data[pos + 2] << 16);
-            if (raw_value & 0x800000) raw_value |= 0xFF000000;
-            break;
-          case 4: raw_value = data[pos] | (data[pos + 1] << 8) | (data[pos + 2] << 16) | (data[pos + 3] << 24); break;
-        }
-      } else {
-        switch (type_info.data_bytes) {
-          case 1: raw_value = data[pos]; break;
-          case 2: raw_value = data[pos] | (data[pos + 1] << 8); break;
-          case 3: raw_value = data[pos] | (data[pos + 1] << 8) | (data[pos + 2] << 16); break;
-          case 4: raw_value = data[pos] | (data[pos + 1] << 8) | (data[pos + 2] << 16) | (data[pos + 3] << 24); break;
-        }
-      }
-      float value = raw_value * type_info.factor;
-      snprintf(val_str, sizeof(val_str), "%s=%.2f", name, value);
+    if (written < 0 || (size_t) written >= avail) {
+      break;  // Buffer full
     }
-    if (!measurements.empty()) measurements += " ";
-    measurements += val_str;
-    pos += type_info.data_bytes;
+    pos += written;
   }
 
-  ESP_LOGI(TAG, "[%s] %s| %s", mac_str, is_encrypted ? "ENC " : "", measurements.c_str());
+  ESP_LOGI(TAG, "[%s] | %s", mac_str, line);
 }
 
 void BTHomeReceiverHub::loop() {
 #ifdef USE_BTHOME_RECEIVER_NIMBLE
-  // Deferred NimBLE initialization - wait for other components to be ready
-  if (!this->nimble_initialized_ && !this->init_attempted_) {
-    // Wait a bit after boot before initializing BLE (use ESP-IDF timer)
-    static int64_t boot_time = esp_timer_get_time();
-    if ((esp_timer_get_time() - boot_time) > 2000000) {  // 2 second delay (microseconds)
-      this->init_attempted_ = true;
-      this->init_nimble_();
-    }
+  // Decode advertisements queued by the NimBLE host task
+  this->drain_advertisement_queue_();
+#endif
+
+  this->flush_pending_publishes_();
+
+#ifdef USE_BTHOME_RECEIVER_NIMBLE
+  // A bounded drain may leave records behind; otherwise sleep until the host task queues one.
+  // A push racing with this check re-enables the loop after this pass.
+  if (!this->adv_queue_.empty()) {
+    return;
   }
 #endif
+  this->disable_loop();
+}
 
-  // Periodic dump of all detected devices
+bool BTHomeReceiverHub::handle_service_data_(uint64_t address, const uint8_t *data, size_t len, int8_t rssi,
+                                             uint32_t timestamp) {
+  // Cache for periodic dump
   if (this->dump_interval_ > 0) {
-    uint32_t now = esp_timer_get_time() / 1000;  // Convert microseconds to milliseconds
-    if (now - this->last_dump_time_ >= this->dump_interval_) {
-      this->last_dump_time_ = now;
-      this->dump_all_devices_();
-    }
+    this->cache_device_data_(address, data, len);
   }
-}
 
-void BTHomeReceiverHub::register_device(BTHomeDevice *device) {
-  this->devices_.push_back(device);
-  ESP_LOGV(TAG, "Registered device: %012llX", device->get_mac_address());
+  // Check if this device is registered
+  auto range = this->find_devices_(address);
+  if (range.first == range.second) {
+    return false;
+  }
+
+  ESP_LOGV(TAG, "Processing BTHome data from registered device %02X:%02X:%02X:%02X:%02X:%02X (%u bytes)",
+           (uint8_t)((address >> 40) & 0xFF), (uint8_t)((address >> 32) & 0xFF),
+           (uint8_t)((address >> 24) & 0xFF), (uint8_t)((address >> 16) & 0xFF),
+           (uint8_t)((address >> 8) & 0xFF), (uint8_t)(address & 0xFF), (unsigned) len);
+
+  // Every device object registered for this MAC gets the advertisement
+  bool handled = false;
+  for (size_t i = range.first; i < range.second; i++) {
+    handled |= this->devices_[i]->parse_advertisement(data, len, rssi, timestamp);
+  }
+  return handled;
 }
 
-BTHomeDevice *BTHomeReceiverHub::find_device_(uint64_t address) {
+void BTHomeReceiverHub::persist_counters_() {
+  size_t written = 0;
   for (auto *device : this->devices_) {
-    if (device->get_mac_address() == address) {
-      return device;
+    if (device->save_counter()) {
+      written++;
     }
   }
-  return nullptr;
+  if (written > 0) {
+    ESP_LOGD(TAG, "Saved %u encryption counters", (unsigned) written);
+  }
 }
 
-void BTHomeReceiverHub::cache_device_data_(uint64_t address, const uint8_t *data, size_t len) {
-  uint32_t now = esp_timer_get_time() / 1000;
+void BTHomeReceiverHub::on_shutdown() {
+  if (this->counter_persist_interval_ > 0) {
+    this->persist_counters_();
+  }
+}
 
-  // Find existing entry or add new one
-  for (auto &entry : this->detected_devices_) {
-    if (entry.first == address) {
-      entry.second.last_data.assign(data, data + len);
-      entry.second.last_seen = now;
-      return;
+void BTHomeReceiverHub::flush_pending_publishes_() {
+  if (this->pending_publishes_.empty()) {
+    return;
+  }
+  // Dispatch tables are fixed after setup, so the entry pointers stay valid. Only the final value
+  // of each entity is compared with its state, so a change and its revert within one pass are
+  // published as the revert.
+  size_t published = 0;
+  for (const PendingPublish &pending : this->pending_publishes_) {
+    const DispatchEntry *entry = pending.entry;
+    entry->pending = false;
+    float value = entry->pending_value;
+    switch (pending.kind) {
+#ifdef USE_SENSOR
+      case ObjectKind::SENSOR:
+        if (!entry->sensor->has_state() || entry->sensor->get_raw_state() != value) {
+          entry->sensor->publish_state(value);
+          published++;
+        }
+        if (pending.history != nullptr) {
+          pending.history->publish(true);
+        }
+        break;
+#endif
+#ifdef USE_BINARY_SENSOR
+      case ObjectKind::BINARY_SENSOR:
+        if (!entry->binary_sensor->has_state() || entry->binary_sensor->state != (value != 0.0f)) {
+          entry->binary_sensor->publish_state(value != 0.0f);
+          published++;
+        }
+        break;
+#endif
+      default:
+        break;
     }
   }
+  ESP_LOGV(TAG, "Published %u of %u batched values", (unsigned) published, (unsigned) this->pending_publishes_.size());
+  this->pending_publishes_.clear();
+}
+
+void BTHomeReceiverHub::register_device(BTHomeDevice *device) {
+  // Insert after any devices with the same MAC to keep registration order stable
+  uint64_t address = device->get_mac_address();
+  auto pos = std::upper_bound(this->device_macs_.begin(), this->device_macs_.end(), address);
+  size_t index = pos - this->device_macs_.begin();
+  this->device_macs_.insert(pos, address);
+  this->devices_.insert(this->devices_.begin() + index, device);
+  device->set_stats(&this->reception_stats_, this->reception_stats_.add_slot());
+  ESP_LOGV(TAG, "Registered device: %012llX", address);
+}
+
+std::pair<size_t, size_t> BTHomeReceiverHub::find_devices_(uint64_t address) const {
+  auto range = std::equal_range(this->device_macs_.begin(), this->device_macs_.end(), address);
+  return {static_cast<size_t>(range.first - this->device_macs_.begin()),
+          static_cast<size_t>(range.second - this->device_macs_.begin())};
+}
 
-  // Add new device
-  DetectedDevice dev;
-  dev.last_data.assign(data, data + len);
-  dev.last_seen = now;
-  this->detected_devices_.emplace_back(address, dev);
+void BTHomeReceiverHub::cache_device_data_(uint64_t address, const uint8_t *data, size_t len) {
+  uint32_t now = esp_timer_get_time() / 1000;
+  this->detected_devices_.update(address, now, data, len);
 }
 
 void BTHomeReceiverHub::dump_all_devices_() {
-  if (this->detected_devices_.empty()) {
+  if (this->detected_devices_.size() == 0) {
     return;
   }
 
   uint32_t now = esp_timer_get_time() / 1000;
 
-  for (const auto &entry : this->detected_devices_) {
-    uint64_t address = entry.first;
-    const DetectedDevice &dev = entry.second;
+  this->detected_devices_.for_each([this, now](const DetectedDevice &dev) {
     uint32_t age_sec = (now - dev.last_seen) / 1000;
 
     // Check if registered
-    bool is_registered = this->find_device_(address) != nullptr;
+    auto range = this->find_devices_(dev.address);
+    bool is_registered = range.first != range.second;
 
     // Parse and dump the cached data
-    this->dump_advertisement_(address, dev.last_data.data(), dev.last_data.size());
+    this->dump_advertisement_(dev.address, dev.data, dev.len);
     if (is_registered) {
       ESP_LOGI(TAG, "  ^ (last seen %us ago) [REGISTERED]", age_sec);
     }
+  });
+
+  ESP_LOGI(TAG, "Detected device cache: %u/%u, evicted %u", (unsigned) this->detected_devices_.size(),
+           (unsigned) this->detected_devices_.capacity(), this->detected_devices_.get_evictions());
+
+  for (auto *device : this->devices_) {
+    uint64_t addr = device->get_mac_address();
+    uint32_t rejected_length = device->get_reject_count(BTHomeDevice::AdmitResult::REJECT_LENGTH);
+    uint32_t rejected_no_key = device->get_reject_count(BTHomeDevice::AdmitResult::REJECT_NO_KEY);
+    uint32_t rejected_replay = device->get_reject_count(BTHomeDevice::AdmitResult::REJECT_REPLAY);
+    if (rejected_length + rejected_no_key + rejected_replay > 0) {
+      ESP_LOGI(TAG, "Rejected %02X:%02X:%02X:%02X:%02X:%02X: length %u, no key %u, replay %u",
+               (uint8_t)((addr >> 40) & 0xFF), (uint8_t)((addr >> 32) & 0xFF), (uint8_t)((addr >> 24) & 0xFF),
+               (uint8_t)((addr >> 16) & 0xFF), (uint8_t)((addr >> 8) & 0xFF), (uint8_t)(addr & 0xFF),
+               rejected_length, rejected_no_key, rejected_replay);
+    }
+    const ReceptionStats &stats = device->get_stats();
+    size_t slot = device->get_stats_slot();
+    if (stats.packets[slot] > 0) {
+      ESP_LOGI(TAG,
+               "Reception %02X:%02X:%02X:%02X:%02X:%02X: %u packets, %u duplicates, %u decrypt failures, "
+               "%u unknown objects, RSSI %d (avg %.1f) dBm, interval %dms, jitter %dms",
+               (uint8_t)((addr >> 40) & 0xFF), (uint8_t)((addr >> 32) & 0xFF), (uint8_t)((addr >> 24) & 0xFF),
+               (uint8_t)((addr >> 16) & 0xFF), (uint8_t)((addr >> 8) & 0xFF), (uint8_t)(addr & 0xFF),
+               stats.packets[slot], stats.duplicates[slot], stats.decrypt_failures[slot], stats.unknown_objects[slot],
+               stats.last_rssi[slot], stats.rssi_avg_x16[slot] / 16.0f, stats.interval_avg[slot], stats.jitter[slot]);
+    }
+    if (device->get_decrypt_count() == 0) {
+      continue;
+    }
+    ESP_LOGI(TAG, "Decrypt %02X:%02X:%02X:%02X:%02X:%02X: %u packets, avg %uus, max %uus",
+             (uint8_t)((addr >> 40) & 0xFF), (uint8_t)((addr >> 32) & 0xFF), (uint8_t)((addr >> 24) & 0xFF),
+             (uint8_t)((addr >> 16) & 0xFF), (uint8_t)((addr >> 8) & 0xFF), (uint8_t)(addr & 0xFF),
+             device->get_decrypt_count(), device->get_decrypt_time_avg_us(), device->get_decrypt_time_max_us());
   }
+
+#ifdef USE_BTHOME_RECEIVER_NIMBLE
+  ESP_LOGI(TAG, "Scan: window %.1fms / interval %.1fms, duty cycle %.1f%%, %.1f adv/s%s", this->scan_window_ * 0.625f,
+           this->scan_interval_ * 0.625f, this->scan_duty_cycle_, this->adv_per_second_,
+           this->filter_active_ ? " (filtered)" : "");
+  ESP_LOGI(TAG, "Advertisement queue: high-water %u/%u, dropped %u", (unsigned) this->adv_queue_.get_high_water_mark(),
+           (unsigned) this->adv_queue_.capacity(), this->adv_queue_.get_dropped());
+#endif
 }
 
 // ============================================================================
@@ -504,35 +480,39 @@ void BTHomeReceiverHub::nimble_host_task_(void *param) {
 void BTHomeReceiverHub::nimble_on_sync_() {
   ESP_LOGI(TAG, "NimBLE host-controller synchronized");
 
-  // Signal that sync is complete
+  // Signal that sync is complete. Scanning is started from the main loop: by init_nimble_() at
+  // boot, by the scan scheduler after a host reset.
   if (nimble_sync_semaphore_ != nullptr) {
     xSemaphoreGive(nimble_sync_semaphore_);
   }
+}
 
-  // Start scanning
+void BTHomeReceiverHub::nimble_on_reset_(int reason) {
+  ESP_LOGW(TAG, "NimBLE host reset, reason: %d", reason);
   if (instance_ != nullptr) {
-    instance_->start_scanning_();
+    instance_->note_scan_ended_();
   }
 }
 
-void BTHomeReceiverHub::nimble_on_reset_(int reason) {
-  ESP_LOGW(TAG, "NimBLE host reset, reason: %d", reason);
+void BTHomeReceiverHub::note_scan_ended_() {
+  this->scan_end_time_.store(esp_timer_get_time() / 1000, std::memory_order_relaxed);
+  this->scan_ended_.store(true, std::memory_order_release);
 }
 
 int BTHomeReceiverHub::nimble_gap_event_(struct ble_gap_event *event, void *arg) {
   switch (event->type) {
     case BLE_GAP_EVENT_DISC:
-      // Advertisement received
+      // Advertisement received - only queued here, decoded later in loop()
       if (instance_ != nullptr) {
         instance_->process_nimble_advertisement(&event->disc);
       }
       break;
 
     case BLE_GAP_EVENT_DISC_COMPLETE:
-      // Discovery completed - restart scanning
-      ESP_LOGD(TAG, "Scan complete, restarting...");
+      // Discovery ended (it runs forever, so only on an error): the scan scheduler restarts it
+      ESP_LOGD(TAG, "Scan complete, reason %d", event->disc_complete.reason);
       if (instance_ != nullptr) {
-        instance_->start_scanning_();
+        instance_->note_scan_ended_();
       }
       break;
 
@@ -552,12 +532,13 @@ void BTHomeReceiverHub::start_scanning_() {
 
   // Passive scanning (don't send scan requests)
   disc_params.passive = 1;
+  // Only report registered devices once the filter accept list is programmed
+  disc_params.filter_policy = this->filter_active_ ? BLE_HCI_SCAN_FILT_USE_WL : BLE_HCI_SCAN_FILT_NO_WL;
   // Filter duplicates disabled to receive all advertisements
   disc_params.filter_duplicates = 0;
-  // Scan interval and window (in 0.625ms units)
-  // 160 = 100ms interval, 80 = 50ms window
-  disc_params.itvl = 160;
-  disc_params.window = 80;
+  // Scan interval and window (in 0.625ms units), set by the scan scheduler
+  disc_params.itvl = this->scan_interval_;
+  disc_params.window = this->scan_window_;
   // Limited discovery mode disabled
   disc_params.limited = 0;
 
@@ -568,7 +549,10 @@ void BTHomeReceiverHub::start_scanning_() {
   }
 
   this->scanning_ = true;
-  ESP_LOGI(TAG, "BLE scanning started");
+  this->scan_window_active_ = this->scan_window_;
+  this->scan_time_checkpoint_ = esp_timer_get_time() / 1000;
+  ESP_LOGD(TAG, "BLE scanning started (window %.1fms / interval %.1fms)", this->scan_window_ * 0.625f,
+           this->scan_interval_ * 0.625f);
 }
 
 void BTHomeReceiverHub::stop_scanning_() {
@@ -577,11 +561,145 @@ void BTHomeReceiverHub::stop_scanning_() {
   }
 
   ble_gap_disc_cancel();
+  this->account_scan_time_(esp_timer_get_time() / 1000);
   this->scanning_ = false;
-  ESP_LOGI(TAG, "BLE scanning stopped");
+  ESP_LOGD(TAG, "BLE scanning stopped");
+}
+
+void BTHomeReceiverHub::account_scan_time_(uint32_t now) {
+  // Accumulate the time the scan actually ran since the checkpoint; the controller listens for the
+  // window of that scan out of every interval
+  if (!this->scanning_) {
+    return;
+  }
+  int32_t elapsed = (int32_t) (now - this->scan_time_checkpoint_);
+  if (elapsed > 0) {
+    this->scan_on_ms_ += elapsed * (float) this->scan_window_active_ / this->scan_interval_;
+    this->scan_time_checkpoint_ = now;
+  }
+}
+
+void BTHomeReceiverHub::update_scan_scheduler_(uint32_t now) {
+  // The host task ended the scan (discovery error or host reset): count it up to that point, then
+  // restart once the host is synced
+  if (this->scan_ended_.exchange(false, std::memory_order_acquire)) {
+    this->account_scan_time_(this->scan_end_time_.load(std::memory_order_relaxed));
+    this->scanning_ = false;
+  }
+  if (!this->scanning_ && ble_hs_synced()) {
+    this->start_scanning_();
+  }
+
+  if (this->scan_stats_start_ == 0) {
+    // First pass after scanning started
+    this->scan_stats_start_ = now;
+    this->scan_scheduler_start_ = now;
+    this->scan_time_checkpoint_ = now;
+    this->last_scan_adapt_time_ = now;
+    this->scan_stats_adv_count_ = this->adv_received_.load(std::memory_order_relaxed);
+    return;
+  }
+
+  // Adaptive window: widen while a registered device is overdue, narrow back once none is
+  if (this->scan_adaptive_ && now - this->last_scan_adapt_time_ >= SCAN_ADAPT_INTERVAL_MS) {
+    this->last_scan_adapt_time_ = now;
+
+    // Devices silent for longer than the give-up time (or never heard since the scheduler started)
+    // are likely gone or out of range; widening for them would keep the radio busy for good
+    const uint32_t give_up = this->scan_overdue_timeout_ * SCAN_OVERDUE_GIVE_UP_FACTOR;
+    bool overdue = false;
+    for (auto *device : this->devices_) {
+      uint32_t last_seen = device->get_last_seen();
+      uint32_t silence = now - (last_seen != 0 ? last_seen : this->scan_scheduler_start_);
+      if (silence > this->scan_overdue_timeout_ && silence <= give_up) {
+        overdue = true;
+        break;
+      }
+    }
+
+    uint16_t window = this->scan_window_;
+    if (overdue) {
+      window = std::min<uint32_t>(this->scan_interval_, window * 2u);
+    } else {
+      window = std::max<uint16_t>(this->scan_window_base_, window / 2);
+    }
+
+    if (window != this->scan_window_) {
+      ESP_LOGD(TAG, "Scan window %.1fms -> %.1fms (%s)", this->scan_window_ * 0.625f, window * 0.625f,
+               overdue ? "device overdue" : "no device overdue");
+      this->scan_window_ = window;
+      this->stop_scanning_();
+      this->start_scanning_();
+    }
+  }
+
+  // Scan statistics
+  uint32_t period = now - this->scan_stats_start_;
+  if (period >= SCAN_STATS_INTERVAL_MS) {
+    this->account_scan_time_(now);
+    uint32_t count = this->adv_received_.load(std::memory_order_relaxed);
+    this->scan_duty_cycle_ = 100.0f * this->scan_on_ms_ / period;
+    this->adv_per_second_ = (count - this->scan_stats_adv_count_) * 1000.0f / period;
+    this->scan_stats_adv_count_ = count;
+    this->scan_stats_start_ = now;
+    this->scan_on_ms_ = 0;
+
+    if (this->filter_accept_list_ && this->dump_interval_ == 0 && !this->filter_reported_) {
+      if (!this->filter_active_) {
+        // Baseline period done: switch to filtered scanning (the list can only change while idle)
+        this->unfiltered_adv_per_second_ = this->adv_per_second_;
+        this->stop_scanning_();
+        this->filter_active_ = this->apply_filter_accept_list_();
+        this->filter_reported_ = !this->filter_active_;
+        this->start_scanning_();
+      } else {
+        ESP_LOGI(TAG, "Filter accept list: host advertisements %.1f/s unfiltered -> %.1f/s filtered",
+                 this->unfiltered_adv_per_second_, this->adv_per_second_);
+        this->filter_reported_ = true;
+      }
+    }
+  }
+}
+
+bool BTHomeReceiverHub::apply_filter_accept_list_() {
+  // The address type of a device is not configured, so each MAC is added as both public and
+  // random. device_macs_ is sorted; devices sharing a MAC are added once.
+  std::vector<ble_addr_t> addrs;
+  addrs.reserve(this->device_macs_.size() * 2);
+  for (size_t i = 0; i < this->device_macs_.size(); i++) {
+    uint64_t mac = this->device_macs_[i];
+    if (i > 0 && mac == this->device_macs_[i - 1]) {
+      continue;
+    }
+    ble_addr_t addr;
+    for (int j = 0; j < 6; j++) {
+      addr.val[j] = (mac >> (j * 8)) & 0xFF;  // NimBLE addresses are LSB first
+    }
+    addr.type = BLE_ADDR_PUBLIC;
+    addrs.push_back(addr);
+    addr.type = BLE_ADDR_RANDOM;
+    addrs.push_back(addr);
+  }
+
+  if (addrs.empty() || addrs.size() > UINT8_MAX) {
+    ESP_LOGW(TAG, "Filter accept list not applied: %u addresses", (unsigned) addrs.size());
+    return false;
+  }
+
+  int rc = ble_gap_wl_set(addrs.data(), addrs.size());
+  if (rc != 0) {
+    // Most likely more addresses than the controller's list holds
+    ESP_LOGW(TAG, "Controller rejected filter accept list of %u addresses (%d), scanning unfiltered",
+             (unsigned) addrs.size(), rc);
+    return false;
+  }
+  ESP_LOGD(TAG, "Filter accept list programmed with %u addresses", (unsigned) addrs.size());
+  return true;
 }
 
 void BTHomeReceiverHub::process_nimble_advertisement(const struct ble_gap_disc_desc *disc) {
+  this->adv_received_.fetch_add(1, std::memory_order_relaxed);
+
   // Convert address to uint64_t (little-endian)
   uint64_t address = 0;
   for (int i = 0; i < 6; i++) {
@@ -611,25 +729,11 @@ void BTHomeReceiverHub::process_nimble_advertisement(const struct ble_gap_disc_d
 
       if (uuid == BTHOME_SERVICE_UUID) {
         // Found BTHome service data (excluding the 2-byte UUID prefix)
-        const uint8_t *service_data = ad_data + 2;
-        size_t service_data_len = ad_data_len - 2;
-
-        // Cache for periodic dump
-        if (this->dump_interval_ > 0) {
-          this->cache_device_data_(address, service_data, service_data_len);
-        }
-
-        // Check if this device is registered
-        BTHomeDevice *device = this->find_device_(address);
-        if (device != nullptr) {
-          std::vector<uint8_t> service_data_vec(service_data, service_data + service_data_len);
-          ESP_LOGV(TAG, "Processing BTHome data from registered device %02X:%02X:%02X:%02X:%02X:%02X (%d bytes)",
-                   (uint8_t)((address >> 40) & 0xFF), (uint8_t)((address >> 32) & 0xFF),
-                   (uint8_t)((address >> 24) & 0xFF), (uint8_t)((address >> 16) & 0xFF),
-                   (uint8_t)((address >> 8) & 0xFF), (uint8_t)(address & 0xFF),
-                   (int)service_data_vec.size());
-          device->parse_advertisement(service_data_vec);
-        }
+        // Copy into the queue; parsing and publishing happen in loop()
+        uint32_t now = esp_timer_get_time() / 1000;
+        this->adv_queue_.push(address, disc->rssi, now, ad_data + 2, ad_data_len - 2);
+        // loop() sleeps while the queue is empty; safe to call from the host task
+        this->enable_loop_soon_any_context();
         return;
       }
     }
@@ -638,6 +742,30 @@ void BTHomeReceiverHub::process_nimble_advertisement(const struct ble_gap_disc_d
   }
 }
 
+void BTHomeReceiverHub::drain_advertisement_queue_() {
+  // Bound the work per pass so a busy host task cannot starve the main loop
+  for (size_t i = 0; i < this->adv_queue_.capacity(); i++) {
+    const AdvertisementRecord *record = this->adv_queue_.front();
+    if (record == nullptr) {
+      break;
+    }
+    this->handle_service_data_(record->address, record->data, record->len, record->rssi, record->timestamp);
+    this->adv_queue_.pop();
+  }
+
+  // Report overflows, rate limited to avoid flooding the log
+  uint32_t dropped = this->adv_queue_.get_dropped();
+  if (dropped != this->last_reported_dropped_) {
+    uint32_t now = esp_timer_get_time() / 1000;
+    if (now - this->last_drop_log_time_ >= QUEUE_DROP_LOG_INTERVAL_MS) {
+      ESP_LOGW(TAG, "Advertisement queue full, dropped %u packets (total %u), consider increasing queue_size",
+               dropped - this->last_reported_dropped_, dropped);
+      this->last_reported_dropped_ = dropped;
+      this->last_drop_log_time_ = now;
+    }
+  }
+}
+
 #endif  // USE_BTHOME_RECEIVER_NIMBLE
 
 // ============================================================================
@@ -650,20 +778,10 @@ bool BTHomeReceiverHub::parse_device(const esphome::esp32_ble_tracker::ESPBTDevi
   // Check if this device has BTHome service data (UUID 0xFCD2)
   for (const auto &service_data : device.get_service_datas()) {
     if (service_data.uuid.get_uuid().uuid.uuid16 == BTHOME_SERVICE_UUID) {
-      // Look up registered device by MAC address
+      // Already running in the main loop (esp32_ble_tracker dispatches from loop())
       uint64_t address = device.address_uint64();
-
-      // Cache for periodic dump
-      if (this->dump_interval_ > 0) {
-        this->cache_device_data_(address, service_data.data.data(), service_data.data.size());
-      }
-
-      BTHomeDevice *device = this->find_device_(address);
-      if (device != nullptr) {
-        ESP_LOGV(TAG, "Processing BTHome advertisement from %012llX", address);
-        return device->parse_advertisement(service_data.data);
-      }
-      return false;
+      return this->handle_service_data_(address, service_data.data.data(), service_data.data.size(), device.get_rssi(),
+                                        esp_timer_get_time() / 1000);
     }
   }
   return false;
@@ -675,23 +793,121 @@ bool BTHomeReceiverHub::parse_device(const esphome::esp32_ble_tracker::ESPBTDevi
 // BTHomeDevice Implementation
 // ============================================================================
 
+BTHomeDevice::~BTHomeDevice() {
+  if (this->encryption_enabled_) {
+    mbedtls_ccm_free(&this->ccm_ctx_);
+  }
+}
+
 void BTHomeDevice::set_encryption_key(const std::array<uint8_t, 16> &key) {
+  if (this->encryption_enabled_) {
+    mbedtls_ccm_free(&this->ccm_ctx_);
+  }
   this->encryption_enabled_ = true;
-  this->encryption_key_ = key;
+
+  // Expand the AES key once; each packet then only builds the nonce and runs auth-decrypt
+  mbedtls_ccm_init(&this->ccm_ctx_);
+  int ret = mbedtls_ccm_setkey(&this->ccm_ctx_, MBEDTLS_CIPHER_ID_AES, key.data(), AES_KEY_SIZE * 8);
+  this->ccm_ready_ = ret == 0;
+  if (!this->ccm_ready_) {
+    ESP_LOGE(TAG, "mbedtls_ccm_setkey failed: %d", ret);
+  }
 }
 
 bool BTHomeDevice::parse_advertisement(const std::vector<uint8_t> &service_data) {
-  if (service_data.size() < 1) {
-    ESP_LOGW(TAG, "Invalid service data: too short");
-    return false;
+  return this->parse_advertisement(service_data.data(), service_data.size());
+}
+
+bool BTHomeDevice::parse_advertisement(const uint8_t *service_data, size_t len) {
+  return this->parse_advertisement(service_data, len, RSSI_UNKNOWN, esp_timer_get_time() / 1000);
+}
+
+static const char *admit_result_to_string(BTHomeDevice::AdmitResult result) {
+  switch (result) {
+    case BTHomeDevice::AdmitResult::REJECT_LENGTH:
+      return "invalid length";
+    case BTHomeDevice::AdmitResult::REJECT_NO_KEY:
+      return "encrypted but no key configured";
+    case BTHomeDevice::AdmitResult::REJECT_REPLAY:
+      return "counter replayed";
+    case BTHomeDevice::AdmitResult::ACCEPT:
+      return "accepted";
+    case BTHomeDevice::AdmitResult::RETRANSMIT:
+      return "retransmit";
+  }
+  return "unknown";
+}
+
+BTHomeDevice::AdmitResult BTHomeDevice::admit_packet_(const uint8_t *service_data, size_t len) const {
+  if (len < 1 || len > MAX_SERVICE_DATA_SIZE) {
+    return AdmitResult::REJECT_LENGTH;
+  }
+  if ((service_data[0] & BTHOME_DEVICE_INFO_ENCRYPTED_MASK) == 0) {
+    return AdmitResult::ACCEPT;
+  }
+  if (!this->encryption_enabled_) {
+    return AdmitResult::REJECT_NO_KEY;
+  }
+  // Encrypted format: device_info(1) + ciphertext + counter(4) + MIC(4)
+  if (len < 1 + bthome_codec::COUNTER_SIZE + bthome_codec::MIC_SIZE) {
+    return AdmitResult::REJECT_LENGTH;
+  }
+  uint32_t counter = bthome_codec::read_encrypted_counter(service_data, len);
+  if (!this->counter_valid_ || counter > this->last_counter_) {
+    return AdmitResult::ACCEPT;
+  }
+  uint32_t age = this->last_counter_ - counter;
+  if (age >= REPLAY_WINDOW_SIZE) {
+    return AdmitResult::REJECT_REPLAY;
+  }
+  if (this->replay_bitmap_ & (1ULL << age)) {
+    // Already accepted: the device retransmitting it
+    return AdmitResult::RETRANSMIT;
+  }
+  // Reordered or late, not seen yet
+  return AdmitResult::ACCEPT;
+}
+
+bool BTHomeDevice::parse_advertisement(const uint8_t *service_data, size_t len, int8_t rssi, uint32_t timestamp) {
+  ReceptionStats &stats = *this->stats_;
+  const size_t slot = this->stats_slot_;
+  stats.record_packet(slot, rssi);
+
+  // Cheap header-only admission before any copying or crypto. last_seen only moves for packets
+  // known to come from the device: unencrypted ones, and encrypted ones once they authenticate.
+  // Encrypted retransmits are not authenticated, so anyone could forge them.
+  AdmitResult admit = this->admit_packet_(service_data, len);
+  bool resync = false;
+  switch (admit) {
+    case AdmitResult::ACCEPT:
+      if ((service_data[0] & BTHOME_DEVICE_INFO_ENCRYPTED_MASK) == 0) {
+        stats.last_seen[slot] = timestamp;
+      }
+      break;
+    case AdmitResult::RETRANSMIT:
+      stats.duplicates[slot]++;
+      ESP_LOGV(TAG, "Skipping retransmitted encrypted packet");
+      return true;  // Successfully handled (by ignoring)
+    default:
+      if (admit == AdmitResult::REJECT_REPLAY &&
+          this->try_resync_(bthome_codec::read_encrypted_counter(service_data, len), timestamp)) {
+        // Counter restarted near 0, e.g. the sender rebooted: a resync candidate if it authenticates
+        resync = true;
+        break;
+      }
+      this->reject_counts_[static_cast<size_t>(admit)]++;
+      ESP_LOGD(TAG, "Rejected packet from %012llX: %s (%u bytes)", this->address_, admit_result_to_string(admit),
+               (unsigned) len);
+      return false;
   }
 
-  // Deduplicate: skip if this is an identical packet (devices often retransmit for reliability)
-  if (service_data == this->last_service_data_) {
+  // Deduplicate: devices retransmit each packet several times for reliability. Encrypted
+  // retransmits were already caught by their counter in admit_packet_().
+  if ((service_data[0] & BTHOME_DEVICE_INFO_ENCRYPTED_MASK) == 0 && this->is_duplicate_(service_data, len)) {
+    stats.duplicates[slot]++;
     ESP_LOGV(TAG, "Skipping duplicate packet");
     return true;  // Successfully handled (by ignoring)
   }
-  this->last_service_data_ = service_data;
 
   // First byte is device_info
   uint8_t device_info = service_data[0];
@@ -701,352 +917,536 @@ bool BTHomeDevice::parse_advertisement(const std::vector<uint8_t> &service_data)
 
   const uint8_t *payload_data;
   size_t payload_len;
-  uint8_t decrypted_buffer[256];
+  uint8_t decrypted_buffer[MAX_SERVICE_DATA_SIZE];
 
   if (is_encrypted) {
-    if (!this->encryption_enabled_) {
-      ESP_LOGW(TAG, "Received encrypted data but no encryption key configured");
-      return false;
-    }
-
-    // Encrypted format: device_info(1) + ciphertext + counter(4) + MIC(4)
-    // The counter and MIC are at the end: [...ciphertext...][counter(4)][MIC(4)]
-    if (service_data.size() < 9) {  // device_info(1) + min_ciphertext(0) + counter(4) + MIC(4)
-      ESP_LOGW(TAG, "Encrypted data too short");
-      return false;
-    }
-
-    // Extract counter from bytes [-8:-4] (4 bytes before the MIC)
-    size_t counter_offset = service_data.size() - 8;
-    uint32_t counter = service_data[counter_offset] | (service_data[counter_offset + 1] << 8) |
-                       (service_data[counter_offset + 2] << 16) | (service_data[counter_offset + 3] << 24);
+    // Length, key and counter were validated by admit_packet_()
+    bthome_codec::EncryptedFrame frame;
+    bthome_codec::split_encrypted_frame(service_data, len, frame);
 
-    ESP_LOGV(TAG, "Counter: %u, last counter: %u", counter, this->last_counter_);
+    ESP_LOGV(TAG, "Counter: %u, last counter: %u", frame.counter, this->last_counter_);
 
-    // Validate counter (replay protection)
-    if (counter <= this->last_counter_) {
-      ESP_LOGW(TAG, "Counter not increased (replay attack?): %u <= %u", counter, this->last_counter_);
+    if (!this->decrypt_payload_(frame, decrypted_buffer)) {
+      stats.decrypt_failures[slot]++;
+      ESP_LOGW(TAG, "Decryption failed");
       return false;
     }
 
-    // Ciphertext is between device_info and counter
-    const uint8_t *ciphertext = service_data.data() + 1;
-    size_t ciphertext_len = service_data.size() - 1 - 4;  // Exclude device_info and counter+MIC
-
-    // Get MAC address (6 bytes)
-    uint8_t mac[6];
-    for (int i = 0; i < 6; i++) {
-      mac[i] = (this->address_ >> (i * 8)) & 0xFF;
-    }
-
-    size_t plaintext_len;
-    if (!this->decrypt_payload_(ciphertext, ciphertext_len, mac, device_info, counter, decrypted_buffer,
-                                 &plaintext_len)) {
-      ESP_LOGW(TAG, "Decryption failed");
-      return false;
+    if (resync) {
+      if (!this->accept_resync_(frame.counter)) {
+        this->reject_counts_[static_cast<size_t>(AdmitResult::REJECT_REPLAY)]++;
+        ESP_LOGD(TAG, "Rejected packet from %012llX: counter %u below replay window (last %u)", this->address_,
+                 frame.counter, this->last_counter_);
+        return false;
+      }
+      ESP_LOGW(TAG, "Counter of %012llX reset from %u to %u, replay window resynchronised", this->address_,
+               this->last_counter_, frame.counter);
+      this->counter_valid_ = false;
     }
+    stats.last_seen[slot] = timestamp;
 
-    // Update last counter after successful decryption
-    this->last_counter_ = counter;
+    // Only authenticated counters move the replay window
+    this->mark_counter_(frame.counter);
 
     payload_data = decrypted_buffer;
-    payload_len = plaintext_len;
-    ESP_LOGV(TAG, "Decrypted %d bytes", plaintext_len);
+    payload_len = frame.ciphertext_len;
+    ESP_LOGV(TAG, "Decrypted %u bytes", (unsigned) frame.ciphertext_len);
   } else {
     // Unencrypted: just skip device_info byte
-    payload_data = service_data.data() + 1;
-    payload_len = service_data.size() - 1;
+    payload_data = service_data + 1;
+    payload_len = len - 1;
   }
 
+  stats.record_update(slot, timestamp);
+
   // Parse measurements
-  this->parse_measurements_(payload_data, payload_len);
+  this->parse_measurements_(payload_data, payload_len, timestamp);
   return true;
 }
 
-bool BTHomeDevice::decrypt_payload_(const uint8_t *ciphertext, size_t ciphertext_len, const uint8_t *mac,
-                                     uint8_t device_info, uint32_t counter, uint8_t *plaintext,
-                                     size_t *plaintext_len) {
-  // BTHome v2 AES-CCM decryption
-  // Nonce: MAC(6) + UUID(2, little-endian) + device_info(1) + counter(4) = 13 bytes
-  uint8_t nonce[13];
-  memcpy(nonce, mac, 6);
-  nonce[6] = BTHOME_SERVICE_UUID & 0xFF;         // 0xD2
-  nonce[7] = (BTHOME_SERVICE_UUID >> 8) & 0xFF;  // 0xFC
-  nonce[8] = device_info;
-  nonce[9] = counter & 0xFF;
-  nonce[10] = (counter >> 8) & 0xFF;
-  nonce[11] = (counter >> 16) & 0xFF;
-  nonce[12] = (counter >> 24) & 0xFF;
-
-  // The ciphertext_len includes the MIC (4 bytes)
-  if (ciphertext_len < 4) {
-    ESP_LOGE(TAG, "Ciphertext too short for MIC");
+void BTHomeDevice::mark_counter_(uint32_t counter) {
+  if (!this->counter_valid_ || counter > this->last_counter_) {
+    uint32_t shift = this->counter_valid_ ? counter - this->last_counter_ : REPLAY_WINDOW_SIZE;
+    this->replay_bitmap_ = shift >= REPLAY_WINDOW_SIZE ? 0 : this->replay_bitmap_ << shift;
+    this->replay_bitmap_ |= 1;
+    this->last_counter_ = counter;
+    this->counter_valid_ = true;
+  } else {
+    this->replay_bitmap_ |= 1ULL << (this->last_counter_ - counter);
+  }
+  this->resync_count_ = 0;
+}
+
+bool BTHomeDevice::try_resync_(uint32_t counter, uint32_t timestamp) {
+  if (this->resync_policy_ == ResyncPolicy::STRICT || counter >= RESYNC_MAX_COUNTER) {
+    return false;
+  }
+  // Bound the AES-CCM work an attacker can cause by replaying old packets
+  if (this->resync_attempted_ && timestamp - this->last_resync_attempt_ < RESYNC_ATTEMPT_INTERVAL_MS) {
     return false;
   }
+  this->resync_attempted_ = true;
+  this->last_resync_attempt_ = timestamp;
+  return true;
+}
+
+bool BTHomeDevice::accept_resync_(uint32_t counter) {
+  if (this->resync_policy_ == ResyncPolicy::IMMEDIATE) {
+    return true;
+  }
+  // Retransmits of the candidate do not count; a counter going backwards restarts the run
+  if (this->resync_count_ > 0 && counter == this->resync_candidate_) {
+    return false;
+  }
+  if (this->resync_count_ > 0 && counter > this->resync_candidate_) {
+    this->resync_count_++;
+  } else {
+    this->resync_count_ = 1;
+  }
+  this->resync_candidate_ = counter;
+  return this->resync_count_ >= this->resync_packets_;
+}
 
-  size_t actual_ciphertext_len = ciphertext_len - 4;
-  const uint8_t *mic = ciphertext + actual_ciphertext_len;
+void BTHomeDevice::load_counter() {
+  uint32_t hash = fnv1_hash("bthome_receiver_counter") ^ (uint32_t) this->address_ ^ (uint32_t) (this->address_ >> 32);
+  this->counter_pref_ = global_preferences->make_preference<uint32_t>(hash, true);
+  this->counter_pref_ready_ = true;
+
+  // 0 is what clear_counter() leaves behind: no counter to restore
+  uint32_t counter;
+  if (!this->counter_pref_.load(&counter) || counter == 0) {
+    return;
+  }
+  // The saved value may lag the last accepted counter by up to the persist interval;
+  // treat everything up to it as seen
+  this->last_counter_ = counter;
+  this->replay_bitmap_ = ~0ULL;
+  this->counter_valid_ = true;
+  this->saved_counter_ = counter;
+  ESP_LOGD(TAG, "Restored counter %u for %012llX", counter, this->address_);
+}
 
-  // Prepare combined buffer for mbedtls (ciphertext + tag)
-  uint8_t combined[256];
-  if (ciphertext_len > sizeof(combined)) {
-    ESP_LOGE(TAG, "Ciphertext too long");
+bool BTHomeDevice::save_counter() {
+  if (!this->counter_pref_ready_ || !this->counter_valid_ || this->last_counter_ == this->saved_counter_) {
+    return false;
+  }
+  if (!this->counter_pref_.save(&this->last_counter_)) {
     return false;
   }
-  memcpy(combined, ciphertext, ciphertext_len);
+  this->saved_counter_ = this->last_counter_;
+  return true;
+}
+
+void BTHomeDevice::clear_counter() {
+  this->counter_valid_ = false;
+  this->last_counter_ = 0;
+  this->replay_bitmap_ = 0;
+  this->resync_count_ = 0;
+  this->resync_attempted_ = false;
+  if (this->counter_pref_ready_ && this->saved_counter_ != 0) {
+    uint32_t cleared = 0;
+    this->counter_pref_.save(&cleared);
+    this->saved_counter_ = 0;
+  }
+  ESP_LOGI(TAG, "Cleared replay counter for %012llX", this->address_);
+}
 
-  mbedtls_ccm_context ctx;
-  mbedtls_ccm_init(&ctx);
+bool BTHomeDevice::is_duplicate_(const uint8_t *service_data, size_t len) {
+  // Key on a 32-bit FNV-1a hash of the whole payload, packet ID (object 0x00) included. A
+  // retransmit repeats both ID and values, while a rebooted sender that restarts its packet IDs
+  // sends different values under the same ID and is not mistaken for a duplicate.
+  uint32_t key = 2166136261u;
+  for (size_t i = 0; i < len; i++) {
+    key = (key ^ service_data[i]) * 16777619u;
+  }
 
-  int ret = mbedtls_ccm_setkey(&ctx, MBEDTLS_CIPHER_ID_AES, this->encryption_key_.data(), 128);
-  if (ret != 0) {
-    ESP_LOGE(TAG, "mbedtls_ccm_setkey failed: %d", ret);
-    mbedtls_ccm_free(&ctx);
+  for (size_t i = 0; i < this->dedup_count_; i++) {
+    if (this->dedup_keys_[i] == key) {
+      return true;
+    }
+  }
+
+  // Replace the oldest key
+  this->dedup_keys_[this->dedup_next_] = key;
+  this->dedup_next_ = (this->dedup_next_ + 1) % DEDUP_WINDOW_SIZE;
+  if (this->dedup_count_ < DEDUP_WINDOW_SIZE) {
+    this->dedup_count_++;
+  }
+  return false;
+}
+
+bool BTHomeDevice::decrypt_payload_(const bthome_codec::EncryptedFrame &frame, uint8_t *plaintext) {
+  if (!this->ccm_ready_) {
+    ESP_LOGE(TAG, "Encryption key not initialized");
     return false;
   }
 
-  ret = mbedtls_ccm_auth_decrypt(&ctx, actual_ciphertext_len, nonce, sizeof(nonce), nullptr, 0, ciphertext, plaintext,
-                                  mic, 4);
-  mbedtls_ccm_free(&ctx);
+  // BTHome v2 AES-CCM decryption
+  uint8_t mac[6];
+  uint8_t nonce[bthome_codec::NONCE_SIZE];
+  bthome_codec::mac_to_bytes(this->address_, mac);
+  bthome_codec::build_nonce(nonce, mac, frame.device_info, frame.counter);
+
+  int64_t start = esp_timer_get_time();
+  int ret = mbedtls_ccm_auth_decrypt(&this->ccm_ctx_, frame.ciphertext_len, nonce, sizeof(nonce), nullptr, 0,
+                                     frame.ciphertext, plaintext, frame.mic, bthome_codec::MIC_SIZE);
+  uint32_t elapsed_us = (uint32_t) (esp_timer_get_time() - start);
+
+  this->decrypt_count_++;
+  this->decrypt_time_total_us_ += elapsed_us;
+  if (elapsed_us > this->decrypt_time_max_us_) {
+    this->decrypt_time_max_us_ = elapsed_us;
+  }
 
   if (ret != 0) {
     ESP_LOGE(TAG, "mbedtls_ccm_auth_decrypt failed: %d", ret);
     return false;
   }
 
-  *plaintext_len = actual_ciphertext_len;
+  ESP_LOGV(TAG, "Decrypted in %uus", elapsed_us);
   return true;
 }
 
-void BTHomeDevice::parse_measurements_(const uint8_t *data, size_t len) {
-  size_t pos = 0;
-
-  // Track how many times we've seen each object_id (for indexed sensors like speed/gusts)
-  // Using std::array instead of std::map for better embedded performance (no dynamic allocation)
-  std::array<uint8_t, 256> object_id_counts{};  // Zero-initialized
+void BTHomeDevice::parse_measurements_(const uint8_t *data, size_t len, uint32_t timestamp) {
+  bthome_codec::ObjectReader reader(data, len);
+  bthome_codec::Object object;
 
-  while (pos < len) {
-    if (pos + 1 > len) {
-      ESP_LOGW(TAG, "Incomplete measurement at offset %d", pos);
+  while (true) {
+    bthome_codec::ReadResult result = reader.next(object);
+    if (result == bthome_codec::ReadResult::END) {
+      break;
+    }
+    if (result == bthome_codec::ReadResult::TRUNCATED) {
+      ESP_LOGW(TAG, "Incomplete data for object 0x%02X at offset %u", object.object_id, (unsigned) object.offset);
+      break;
+    }
+    if (result == bthome_codec::ReadResult::UNKNOWN_OBJECT) {
+      this->stats_->unknown_objects[this->stats_slot_]++;
+      // Dump entire packet for debugging unknown object IDs
+      char hex_dump[MAX_SERVICE_DATA_SIZE * 3];
+      append_hex(hex_dump, sizeof(hex_dump), 0, data, len);
+      ESP_LOGW(TAG, "Unknown object ID: 0x%02X at pos %u, full packet: %s", object.object_id,
+               (unsigned) object.offset, hex_dump);
+      // We don't know its size, so we have to stop parsing
       break;
     }
 
-    uint8_t object_id = data[pos++];
-    ESP_LOGV(TAG, "Object ID: 0x%02X at offset %d", object_id, pos - 1);
-
-    // Get current index for this object_id (0 for first occurrence, 1 for second, etc.)
-    uint8_t current_index = object_id_counts[object_id]++;  // Post-increment
+    uint8_t object_id = object.object_id;
+    const ObjectTypeInfo &type_info = *object.type;
+    ESP_LOGV(TAG, "Object ID: 0x%02X at offset %u", object_id, (unsigned) object.offset);
 
-    // Handle special types: button, dimmer, text, raw
-    if (object_id == OBJECT_ID_BUTTON) {
-      // Button event: object_id(1) + event_type(1)
-      // Per BTHome v2 spec: Multiple buttons are represented by multiple sequential 0x3A objects
-      // The order of 0x3A objects determines button index (0=first, 1=second, etc.)
-      // See: https://bthome.io/format/ - "Multiple events of the same type"
-      if (pos + 1 > len) {
-        ESP_LOGW(TAG, "Incomplete button event");
-        break;
-      }
-      uint8_t event_type = data[pos++];
-      uint8_t button_index = current_index;  // Use sequential index based on order
-      ESP_LOGV(TAG, "Button event: index=%d, type=0x%02X", button_index, event_type);
-      this->handle_button_event_(button_index, event_type);
+    // Fast path: objects no entity or trigger subscribed to are already skipped by the reader
+    if (!this->is_subscribed_(object_id)) {
       continue;
     }
 
-    if (object_id == OBJECT_ID_DIMMER) {
-      // Dimmer event: object_id(1) + steps(1, signed)
-      // Per BTHome v2 spec: Multiple dimmers are represented by multiple sequential 0x3C objects
-      // The order of 0x3C objects determines dimmer index (0=first, 1=second, etc.)
-      if (pos + 1 > len) {
-        ESP_LOGW(TAG, "Incomplete dimmer event");
+    switch (type_info.kind) {
+      case ObjectKind::BUTTON: {
+        // Button event: object_id(1) + event_type(1)
+        // Per BTHome v2 spec: Multiple buttons are represented by multiple sequential 0x3A objects
+        // The order of 0x3A objects determines button index (0=first, 1=second, etc.)
+        // See: https://bthome.io/format/ - "Multiple events of the same type"
+        uint8_t event_type = object.data[0];
+        ESP_LOGV(TAG, "Button event: index=%d, type=0x%02X", object.index, event_type);
+        auto entries = this->find_dispatch_entries_(object_id, object.index);
+        for (auto *entry = entries.first; entry != entries.second; entry++) {
+          if (entry->event_type == event_type) {
+            entry->button_trigger->trigger();
+          }
+        }
         break;
       }
-      int8_t steps = static_cast<int8_t>(data[pos++]);
-      uint8_t dimmer_index = current_index;  // Use sequential index based on order
-      ESP_LOGV(TAG, "Dimmer event: index=%d, steps=%d", dimmer_index, steps);
-      this->handle_dimmer_event_(dimmer_index, steps);
-      continue;
-    }
 
-    if (object_id == OBJECT_ID_TEXT) {
-      // Text: object_id(1) + length(1) + UTF-8 string
-      if (pos + 1 > len) {
-        ESP_LOGW(TAG, "Incomplete text length");
-        break;
-      }
-      uint8_t text_len = data[pos++];
-      if (pos + text_len > len) {
-        ESP_LOGW(TAG, "Incomplete text data");
+      case ObjectKind::DIMMER: {
+        // Dimmer event: object_id(1) + steps(1, signed)
+        // Multiple dimmers are represented by multiple sequential 0x3C objects, indexed by order
+        int8_t steps = static_cast<int8_t>(object.data[0]);
+        ESP_LOGV(TAG, "Dimmer event: index=%d, steps=%d", object.index, steps);
+        auto entries = this->find_dispatch_entries_(object_id, object.index);
+        for (auto *entry = entries.first; entry != entries.second; entry++) {
+          entry->dimmer_trigger->trigger(steps);
+        }
         break;
       }
-      std::string text(reinterpret_cast<const char *>(data + pos), text_len);
-      pos += text_len;
-      ESP_LOGV(TAG, "Text: '%s'", text.c_str());
-      this->publish_text_value_(object_id, text);
-      continue;
-    }
 
-    if (object_id == OBJECT_ID_RAW) {
-      // Raw: object_id(1) + length(1) + raw bytes (display as hex)
-      if (pos + 1 > len) {
-        ESP_LOGW(TAG, "Incomplete raw length");
+#ifdef USE_TEXT_SENSOR
+      case ObjectKind::TEXT: {
+        // Text: object_id(1) + length(1) + UTF-8 string
+        auto entries = this->find_dispatch_entries_(object_id, 0);
+        if (entries.first == entries.second) {
+          break;
+        }
+        std::string text(reinterpret_cast<const char *>(object.data), object.data_len);
+        ESP_LOGV(TAG, "Text: '%s'", text.c_str());
+        for (auto *entry = entries.first; entry != entries.second; entry++) {
+          entry->text_sensor->publish_state(text);
+        }
         break;
       }
-      uint8_t raw_len = data[pos++];
-      if (pos + raw_len > len) {
-        ESP_LOGW(TAG, "Incomplete raw data");
+
+      case ObjectKind::RAW: {
+        // Raw: object_id(1) + length(1) + raw bytes (display as hex)
+        auto entries = this->find_dispatch_entries_(object_id, 0);
+        if (entries.first == entries.second) {
+          break;
+        }
+        char hex_str[MAX_SERVICE_DATA_SIZE * 3];
+        append_hex(hex_str, sizeof(hex_str), 0, object.data, object.data_len);
+        ESP_LOGV(TAG, "Raw: %s", hex_str);
+        for (auto *entry = entries.first; entry != entries.second; entry++) {
+          entry->text_sensor->publish_state(hex_str);
+        }
         break;
       }
-      // Convert to hex string
-      std::string hex_str;
-      for (uint8_t i = 0; i < raw_len; i++) {
-        char hex[3];
-        snprintf(hex, sizeof(hex), "%02X", data[pos + i]);
-        if (i > 0)
-          hex_str += " ";
-        hex_str += hex;
-      }
-      pos += raw_len;
-      ESP_LOGV(TAG, "Raw: %s", hex_str.c_str());
-      this->publish_text_value_(object_id, hex_str);
-      continue;
-    }
+#endif
 
-    // Look up standard object type
-    auto it = OBJECT_TYPE_MAP.find(object_id);
-    if (it == OBJECT_TYPE_MAP.end()) {
-      // Dump entire packet for debugging unknown object IDs
-      std::string hex_dump;
-      for (size_t i = 0; i < len; i++) {
-        char hex[4];
-        snprintf(hex, sizeof(hex), "%02X ", data[i]);
-        hex_dump += hex;
+#ifdef USE_BINARY_SENSOR
+      case ObjectKind::BINARY_SENSOR: {
+        // Binary sensor: single byte, 0x00 or 0x01
+        auto entries = this->find_dispatch_entries_(object_id, 0);
+        bool value = object.data[0] != 0;
+        ESP_LOGV(TAG, "Binary sensor 0x%02X: %s", object_id, value ? "ON" : "OFF");
+        bool batch = this->parent_->is_batch_publish();
+        for (auto *entry = entries.first; entry != entries.second; entry++) {
+          if (!batch) {
+            entry->binary_sensor->publish_state(value);
+          } else {
+            this->parent_->defer_publish(entry, ObjectKind::BINARY_SENSOR, value);
+          }
+        }
+        break;
       }
-      ESP_LOGW(TAG, "Unknown object ID: 0x%02X at pos %d, full packet: %s", object_id, pos - 1, hex_dump.c_str());
-      // Skip this measurement - we don't know its size, so we have to stop parsing
-      break;
-    }
-
-    const ObjectTypeInfo &type_info = it->second;
-
-    // Check if we have enough data
-    if (pos + type_info.data_bytes > len) {
-      ESP_LOGW(TAG, "Incomplete data for object 0x%02X (need %d bytes, have %d)", object_id, type_info.data_bytes,
-               len - pos);
-      break;
-    }
+#endif
 
-    // Decode value based on type
-    if (type_info.is_binary_sensor) {
-      // Binary sensor: single byte, 0x00 or 0x01
-      bool value = data[pos] != 0;
-      pos += type_info.data_bytes;
-      ESP_LOGV(TAG, "Binary sensor 0x%02X: %s", object_id, value ? "ON" : "OFF");
-      this->publish_binary_sensor_value_(object_id, value);
-    } else if (type_info.is_sensor) {
-      // Numeric sensor: decode based on data_bytes and signedness
-      int32_t raw_value = 0;
-
-      if (type_info.is_signed) {
-        // Signed integer (little-endian)
-        switch (type_info.data_bytes) {
-          case 1:
-            raw_value = static_cast<int8_t>(data[pos]);
-            break;
-          case 2:
-            raw_value = static_cast<int16_t>(data[pos] | (data[pos + 1] << 8));
-            break;
-          case 3:
-            // sint24: sign-extend from 24 bits to 32 bits
-            raw_value = data[pos] | (data[pos + 1] << 8) | (data[pos + 2] << 16);
-            if (raw_value & 0x800000)
-              raw_value |= 0xFF000000;  // Sign extend
-            break;
-          case 4:
-            raw_value = data[pos] | (data[pos + 1] << 8) | (data[pos + 2] << 16) | (data[pos + 3] << 24);
-            break;
+#ifdef USE_SENSOR
+      case ObjectKind::SENSOR: {
+        // Numeric sensor: decode only when this occurrence has a subscriber
+        auto entries = this->find_dispatch_entries_(object_id, object.index);
+        if (entries.first == entries.second) {
+          ESP_LOGV(TAG, "No subscriber for object 0x%02X[%d], skipping", object_id, object.index);
+          break;
         }
-      } else {
-        // Unsigned integer (little-endian)
-        uint32_t unsigned_value = 0;
-        switch (type_info.data_bytes) {
-          case 1:
-            unsigned_value = data[pos];
-            break;
-          case 2:
-            unsigned_value = data[pos] | (data[pos + 1] << 8);
-            break;
-          case 3:
-            unsigned_value = data[pos] | (data[pos + 1] << 8) | (data[pos + 2] << 16);
-            break;
-          case 4:
-            unsigned_value = data[pos] | (data[pos + 1] << 8) | (data[pos + 2] << 16) | (data[pos + 3] << 24);
-            break;
+        float value = bthome_codec::decode_value(type_info, object.data);
+        ESP_LOGV(TAG, "Sensor 0x%02X[%d]: value=%.3f", object_id, object.index, value);
+        for (auto *entry = entries.first; entry != entries.second; entry++) {
+          // History records every value, before the entity's rate limit
+          if (entry->history != DispatchEntry::NO_HISTORY) {
+            this->histories_[entry->history].history->add(timestamp, value);
+          }
+          this->publish_sensor_(*entry, value, timestamp);
         }
-        raw_value = unsigned_value;
+        break;
       }
+#endif
 
-      pos += type_info.data_bytes;
-
-      // Apply factor to convert to actual value
-      float value = raw_value * type_info.factor;
-      ESP_LOGV(TAG, "Sensor 0x%02X[%d]: raw=%d, value=%.3f", object_id, current_index, raw_value, value);
-      this->publish_sensor_value_(object_id, current_index, value);
+      default:
+        break;
     }
   }
 }
 
-void BTHomeDevice::publish_sensor_value_(uint8_t object_id, uint8_t index, float value) {
 #ifdef USE_SENSOR
-  for (auto *sensor_obj : this->sensors_) {
-    if (sensor_obj->get_object_id() == object_id && sensor_obj->get_index() == index) {
-      sensor_obj->get_sensor()->publish_state(value);
-      return;
+void BTHomeDevice::add_sensor(uint8_t object_id, uint8_t index, sensor::Sensor *sensor, uint32_t min_interval,
+                              float delta) {
+  DispatchEntry &entry = this->add_dispatch_entry_(object_id, index);
+  entry.sensor = sensor;
+  if ((min_interval > 0 || delta > 0.0f) && this->publish_filters_.size() < DispatchEntry::NO_FILTER) {
+    entry.filter = this->publish_filters_.size();
+    this->publish_filters_.push_back({min_interval, delta, 0, NAN});
+  }
+}
+
+void BTHomeDevice::publish_sensor_(const DispatchEntry &entry, float value, uint32_t now) {
+  if (entry.filter != DispatchEntry::NO_FILTER) {
+    PublishFilter &filter = this->publish_filters_[entry.filter];
+    if (!std::isnan(filter.last_value)) {
+      if (now - filter.last_publish < filter.min_interval) {
+        return;
+      }
+      if (std::fabs(value - filter.last_value) < filter.delta) {
+        return;
+      }
     }
+    filter.last_publish = now;
+    filter.last_value = value;
+  }
+
+  // The aggregates follow the entity's publishes, so the rate limit and batching cover them too
+  const SensorHistoryEntry *history =
+      entry.history != DispatchEntry::NO_HISTORY ? &this->histories_[entry.history] : nullptr;
+  if (!this->parent_->is_batch_publish()) {
+    entry.sensor->publish_state(value);
+    if (history != nullptr) {
+      history->publish(false);
+    }
+  } else {
+    this->parent_->defer_publish(&entry, ObjectKind::SENSOR, value, history);
   }
-#endif
-  ESP_LOGV(TAG, "No sensor registered for object ID 0x%02X index %d", object_id, index);
 }
 
-void BTHomeDevice::publish_binary_sensor_value_(uint8_t object_id, bool value) {
-#ifdef USE_BINARY_SENSOR
-  for (auto *sensor_obj : this->binary_sensors_) {
-    if (sensor_obj->get_object_id() == object_id) {
-      sensor_obj->get_sensor()->publish_state(value);
+void BTHomeDevice::add_sensor_history(uint8_t object_id, uint8_t index, sensor::Sensor *sensor, size_t max_samples,
+                                      uint32_t window_ms, float resolution, sensor::Sensor *min_sensor,
+                                      sensor::Sensor *max_sensor, sensor::Sensor *mean_sensor,
+                                      sensor::Sensor *sum_sensor) {
+  uint16_t key = DispatchEntry::make_key(object_id, index);
+  for (auto &entry : this->dispatch_table_) {
+    if (entry.key != key || entry.sensor != sensor) {
+      continue;
+    }
+    if (this->histories_.size() >= DispatchEntry::NO_HISTORY) {
+      ESP_LOGW(TAG, "Too many sensor histories, ignoring '%s'", sensor->get_name().c_str());
       return;
     }
+    std::unique_ptr<SensorHistory> history(new SensorHistory());
+    if (!history->init(max_samples, window_ms, resolution)) {
+      ESP_LOGE(TAG, "Could not allocate %u history samples for '%s'", (unsigned) max_samples,
+               sensor->get_name().c_str());
+      return;
+    }
+    entry.history = this->histories_.size();
+    this->histories_.push_back({std::move(history), min_sensor, max_sensor, mean_sensor, sum_sensor});
+    return;
   }
-#endif
-  ESP_LOGV(TAG, "No binary sensor registered for object ID 0x%02X", object_id);
 }
 
-void BTHomeDevice::publish_text_value_(uint8_t object_id, const std::string &value) {
-#ifdef USE_TEXT_SENSOR
-  for (auto *sensor_obj : this->text_sensors_) {
-    if (sensor_obj->get_object_id() == object_id) {
-      sensor_obj->get_sensor()->publish_state(value);
-      return;
+void BTHomeDevice::expire_histories(uint32_t now) {
+  for (auto &entry : this->histories_) {
+    size_t before = entry.history->size();
+    entry.history->expire(now);
+    if (entry.history->size() != before) {
+      entry.publish(this->parent_->is_batch_publish());
     }
   }
-#endif
-  ESP_LOGV(TAG, "No text sensor registered for object ID 0x%02X", object_id);
 }
 
-void BTHomeDevice::handle_button_event_(uint8_t button_index, uint8_t event_type) {
-  for (auto *trigger : this->button_triggers_) {
-    if (trigger->get_button_index() == button_index && trigger->get_event_type() == event_type) {
-      trigger->trigger();
+void SensorHistoryEntry::publish(bool skip_unchanged) const {
+  const std::pair<sensor::Sensor *, float> aggregates[] = {
+      {this->min_sensor, this->history->get_min()},
+      {this->max_sensor, this->history->get_max()},
+      {this->mean_sensor, this->history->get_mean()},
+      {this->sum_sensor, this->history->get_sum()},
+  };
+  for (const auto &aggregate : aggregates) {
+    sensor::Sensor *sensor = aggregate.first;
+    if (sensor == nullptr) {
+      continue;
+    }
+    // NAN never equals the state, so an empty window is always published
+    if (skip_unchanged && sensor->has_state() && sensor->get_raw_state() == aggregate.second) {
+      continue;
     }
+    sensor->publish_state(aggregate.second);
+  }
+}
+
+void BTHomeDevice::set_stat_sensor(StatSensor stat, sensor::Sensor *sensor) {
+  if (!this->stat_sensors_) {
+    this->stat_sensors_.reset(new std::array<sensor::Sensor *, STAT_SENSOR_COUNT>{});
   }
+  (*this->stat_sensors_)[static_cast<size_t>(stat)] = sensor;
 }
 
-void BTHomeDevice::handle_dimmer_event_(uint8_t dimmer_index, int8_t steps) {
-  for (auto *trigger : this->dimmer_triggers_) {
-    if (trigger->get_dimmer_index() == dimmer_index) {
-      trigger->trigger(steps);
+void BTHomeDevice::publish_stat_sensors(uint32_t now) {
+  if (!this->stat_sensors_) {
+    return;
+  }
+  const ReceptionStats &stats = *this->stats_;
+  const size_t slot = this->stats_slot_;
+  for (size_t i = 0; i < STAT_SENSOR_COUNT; i++) {
+    sensor::Sensor *sens = (*this->stat_sensors_)[i];
+    if (sens == nullptr) {
+      continue;
     }
+    float value = NAN;
+    switch (static_cast<StatSensor>(i)) {
+      case StatSensor::PACKETS:
+        value = stats.packets[slot];
+        break;
+      case StatSensor::DUPLICATES:
+        value = stats.duplicates[slot];
+        break;
+      case StatSensor::DECRYPT_FAILURES:
+        value = stats.decrypt_failures[slot];
+        break;
+      case StatSensor::REPLAYS:
+        value = this->get_reject_count(AdmitResult::REJECT_REPLAY);
+        break;
+      case StatSensor::UNKNOWN_OBJECTS:
+        value = stats.unknown_objects[slot];
+        break;
+      case StatSensor::RSSI:
+        if (stats.last_rssi[slot] != RSSI_UNKNOWN) {
+          value = stats.last_rssi[slot];
+        }
+        break;
+      case StatSensor::RSSI_AVERAGE:
+        if (stats.last_rssi[slot] != RSSI_UNKNOWN) {
+          value = stats.rssi_avg_x16[slot] / 16.0f;
+        }
+        break;
+      case StatSensor::JITTER:
+        value = stats.jitter[slot];
+        break;
+      case StatSensor::LAST_SEEN_AGE:
+        // Unknown until the first packet
+        if (stats.last_seen[slot] != 0) {
+          value = (now - stats.last_seen[slot]) / 1000.0f;
+        }
+        break;
+    }
+    sens->publish_state(value);
+  }
+}
+#endif
+
+#ifdef USE_BINARY_SENSOR
+void BTHomeDevice::add_binary_sensor(uint8_t object_id, binary_sensor::BinarySensor *sensor) {
+  this->add_dispatch_entry_(object_id, 0).binary_sensor = sensor;
+}
+#endif
+
+#ifdef USE_TEXT_SENSOR
+void BTHomeDevice::add_text_sensor(uint8_t object_id, text_sensor::TextSensor *sensor) {
+  this->add_dispatch_entry_(object_id, 0).text_sensor = sensor;
+}
+#endif
+
+void BTHomeDevice::add_button_trigger(BTHomeButtonTrigger *trigger) {
+  DispatchEntry &entry = this->add_dispatch_entry_(OBJECT_ID_BUTTON, trigger->get_button_index());
+  entry.event_type = trigger->get_event_type();
+  entry.button_trigger = trigger;
+}
+
+void BTHomeDevice::add_dimmer_trigger(BTHomeDimmerTrigger *trigger) {
+  this->add_dispatch_entry_(OBJECT_ID_DIMMER, trigger->get_dimmer_index()).dimmer_trigger = trigger;
+}
+
+DispatchEntry &BTHomeDevice::add_dispatch_entry_(uint8_t object_id, uint8_t index) {
+  // Registration happens once at boot; keep the table sorted so lookups can binary search
+  this->subscribed_[object_id >> 5] |= 1u << (object_id & 0x1F);
+
+  uint16_t key = DispatchEntry::make_key(object_id, index);
+  auto pos = std::upper_bound(this->dispatch_table_.begin(), this->dispatch_table_.end(), key,
+                              [](uint16_t k, const DispatchEntry &entry) { return k < entry.key; });
+  DispatchEntry entry{};
+  entry.key = key;
+  entry.filter = DispatchEntry::NO_FILTER;
+  entry.history = DispatchEntry::NO_HISTORY;
+  return *this->dispatch_table_.insert(pos, entry);
+}
+
+std::pair<const DispatchEntry *, const DispatchEntry *> BTHomeDevice::find_dispatch_entries_(uint8_t object_id,
+                                                                                              uint8_t index) const {
+  uint16_t key = DispatchEntry::make_key(object_id, index);
+  const DispatchEntry *begin = this->dispatch_table_.data();
+  const DispatchEntry *end = begin + this->dispatch_table_.size();
+  const DispatchEntry *first =
+      std::lower_bound(begin, end, key, [](const DispatchEntry &entry, uint16_t k) { return entry.key < k; });
+  const DispatchEntry *last = first;
+  while (last != end && last->key == key) {
+    last++;
   }
+  return {first, last};
 }
 
 }  // namespace bthome_receiver
@@ -1,12 +1,18 @@
 #pragma once
 
+#include "esphome/core/defines.h"
 #include "esphome/core/component.h"
 #include "esphome/core/helpers.h"
 #include "esphome/core/automation.h"
+#include "esphome/core/preferences.h"
+#include "esphome/components/bthome_codec/bthome_codec.h"
+#include "sensor_history.h"
 
 // ESP-IDF timer for time tracking
 #include <esp_timer.h>
 
+#include "mbedtls/ccm.h"
+
 // Platform-specific includes based on BLE stack
 #ifdef USE_BTHOME_RECEIVER_NIMBLE
   // NimBLE stack (lighter weight, observer-only)
@@ -32,106 +38,35 @@
 #endif
 
 #include <vector>
-#include <map>
 #include <array>
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstring>
+#include <memory>
 
 namespace esphome {
 namespace bthome_receiver {
 
-// BTHome v2 constants
-static const uint16_t BTHOME_SERVICE_UUID = 0xFCD2;
-
-// Device info byte format: bit 0 = encryption, bit 2 = trigger-based
-static const uint8_t BTHOME_DEVICE_INFO_ENCRYPTED_MASK = 0x01;
-
-// Special object IDs for events and variable-length data
-static const uint8_t OBJECT_ID_BUTTON = 0x3A;
-static const uint8_t OBJECT_ID_DIMMER = 0x3C;
-static const uint8_t OBJECT_ID_TEXT = 0x53;
-static const uint8_t OBJECT_ID_RAW = 0x54;
-
-// Button event types (BTHome v2 spec object ID 0x3A)
-static const uint8_t BUTTON_EVENT_NONE = 0x00;
-static const uint8_t BUTTON_EVENT_PRESS = 0x01;
-static const uint8_t BUTTON_EVENT_DOUBLE_PRESS = 0x02;
-static const uint8_t BUTTON_EVENT_TRIPLE_PRESS = 0x03;
-static const uint8_t BUTTON_EVENT_LONG_PRESS = 0x04;
-static const uint8_t BUTTON_EVENT_LONG_DOUBLE_PRESS = 0x05;
-static const uint8_t BUTTON_EVENT_LONG_TRIPLE_PRESS = 0x06;
-static const uint8_t BUTTON_EVENT_HOLD_PRESS = 0x80;
-
-// Encryption constants
-static const size_t AES_KEY_SIZE = 16;
-
-// Object type info for parsing BTHome data
-struct ObjectTypeInfo {
-  uint8_t data_bytes;
-  bool is_signed;
-  float factor;
-  bool is_sensor;
-  bool is_binary_sensor;
-};
+// BTHome v2 protocol definitions shared with the sender
+using bthome_codec::AES_KEY_SIZE;
+using bthome_codec::BTHOME_DEVICE_INFO_ENCRYPTED_MASK;
+using bthome_codec::BTHOME_SERVICE_UUID;
+using bthome_codec::BUTTON_EVENT_PRESS;
+using bthome_codec::ObjectKind;
+using bthome_codec::ObjectTypeInfo;
+using bthome_codec::OBJECT_ID_BUTTON;
+using bthome_codec::OBJECT_ID_DIMMER;
+using bthome_codec::OBJECT_ID_RAW;
+using bthome_codec::OBJECT_ID_TEXT;
+
+// Largest service data payload that fits in a legacy BLE advertisement
+static const size_t MAX_SERVICE_DATA_SIZE = 31;
 
 // Forward declarations
 class BTHomeReceiverHub;
 class BTHomeDevice;
-
-// =============================================================================
-// BTHomeSensor - Represents a numeric sensor value from a BTHome device
-// Supports indexing for multiple sensors of the same object_id (e.g., speed + gusts)
-// =============================================================================
-#ifdef USE_SENSOR
-class BTHomeSensor {
- public:
-  BTHomeSensor(uint8_t object_id, uint8_t index, sensor::Sensor *sensor)
-      : object_id_(object_id), index_(index), sensor_(sensor) {}
-
-  uint8_t get_object_id() const { return this->object_id_; }
-  uint8_t get_index() const { return this->index_; }
-  sensor::Sensor *get_sensor() { return this->sensor_; }
-
- protected:
-  uint8_t object_id_;
-  uint8_t index_;  // For multiple sensors of same type (0=first, 1=second, etc.)
-  sensor::Sensor *sensor_;
-};
-#endif
-
-// =============================================================================
-// BTHomeBinarySensor - Represents a boolean sensor value from a BTHome device
-// =============================================================================
-#ifdef USE_BINARY_SENSOR
-class BTHomeBinarySensor {
- public:
-  BTHomeBinarySensor(uint8_t object_id, binary_sensor::BinarySensor *sensor)
-      : object_id_(object_id), sensor_(sensor) {}
-
-  uint8_t get_object_id() const { return this->object_id_; }
-  binary_sensor::BinarySensor *get_sensor() { return this->sensor_; }
-
- protected:
-  uint8_t object_id_;
-  binary_sensor::BinarySensor *sensor_;
-};
-#endif
-
-// =============================================================================
-// BTHomeTextSensor - Represents text/raw data from a BTHome device
-// =============================================================================
-#ifdef USE_TEXT_SENSOR
-class BTHomeTextSensor {
- public:
-  BTHomeTextSensor(uint8_t object_id, text_sensor::TextSensor *sensor)
-      : object_id_(object_id), sensor_(sensor) {}
-
-  uint8_t get_object_id() const { return this->object_id_; }
-  text_sensor::TextSensor *get_sensor() { return this->sensor_; }
-
- protected:
-  uint8_t object_id_;
-  text_sensor::TextSensor *sensor_;
-};
-#endif
+struct SensorHistoryEntry;
 
 // =============================================================================
 // BTHomeButtonTrigger - Automation trigger for button events
@@ -165,86 +100,545 @@ class BTHomeDimmerTrigger : public Trigger<int8_t>, public Parented<BTHomeDevice
   uint8_t dimmer_index_{0};
 };
 
+// =============================================================================
+// DispatchEntry - Subscriber for one (object_id, index) pair of a device
+// Sensors, buttons and dimmers use the occurrence index within the packet;
+// binary and text sensors always use index 0.
+// =============================================================================
+struct DispatchEntry {
+  static constexpr uint8_t NO_FILTER = 0xFF;
+  static constexpr uint8_t NO_HISTORY = 0xFF;
+
+  uint16_t key;  // (object_id << 8) | index
+  union {
+    uint8_t event_type;  // Buttons: event type
+    uint8_t history;     // Sensors: index into the device's histories, NO_HISTORY if none
+  };
+  uint8_t filter;  // Index into the device's publish filters, NO_FILTER if not rate limited
+  // Batch publish: set while the entry is queued on the hub. Lookups hand out const entries,
+  // so the slot is mutable; only the main loop touches it.
+  mutable bool pending;
+  union {
+#ifdef USE_SENSOR
+    sensor::Sensor *sensor;
+#endif
+#ifdef USE_BINARY_SENSOR
+    binary_sensor::BinarySensor *binary_sensor;
+#endif
+#ifdef USE_TEXT_SENSOR
+    text_sensor::TextSensor *text_sensor;
+#endif
+    BTHomeButtonTrigger *button_trigger;
+    BTHomeDimmerTrigger *dimmer_trigger;
+  };
+  mutable float pending_value;  // Last value decoded while pending; later packets overwrite it
+
+  static constexpr uint16_t make_key(uint8_t object_id, uint8_t index) { return (object_id << 8) | index; }
+};
+
+// Per-entity publish rate limit for numeric sensors
+struct PublishFilter {
+  uint32_t min_interval;  // ms between publishes, 0 = no limit
+  float delta;            // Minimum change from the last published value, 0 = any change
+  uint32_t last_publish;
+  float last_value;       // NAN until the first publish
+};
+
+#ifdef USE_SENSOR
+// Time-series history of one sensor entity and the sensors publishing its aggregates
+struct SensorHistoryEntry {
+  std::unique_ptr<SensorHistory> history;
+  sensor::Sensor *min_sensor;
+  sensor::Sensor *max_sensor;
+  sensor::Sensor *mean_sensor;
+  sensor::Sensor *sum_sensor;
+
+  // Publish the aggregates; skip_unchanged leaves sensors already in that state alone
+  void publish(bool skip_unchanged) const;
+};
+#endif
+
+// An entity with a decoded value waiting for the hub's next batch publish
+struct PendingPublish {
+  const DispatchEntry *entry;
+  ObjectKind kind;                    // SENSOR or BINARY_SENSOR
+  const SensorHistoryEntry *history;  // Aggregates published along with a sensor, or nullptr
+};
+
+// =============================================================================
+// ReceptionStats - Per-device reception statistics as a struct of arrays
+// Owned by the hub, one column per field, indexed by the slot each device gets in
+// register_device(). A packet only touches the columns it changes.
+// =============================================================================
+static const int8_t RSSI_UNKNOWN = INT8_MIN;
+
+struct ReceptionStats {
+  std::vector<uint32_t> packets;           // Packets received from the MAC, before admission
+  std::vector<uint32_t> duplicates;        // Retransmits and identical payloads skipped
+  std::vector<uint32_t> decrypt_failures;  // Packets failing AES-CCM authentication
+  std::vector<uint32_t> unknown_objects;   // Packets cut short by an object ID not in BTHome v2
+  std::vector<uint32_t> last_seen;         // Last admitted packet, ms since boot (0 = never)
+  std::vector<uint32_t> last_update;       // Last new (non-duplicate) packet, ms since boot
+  std::vector<int32_t> interval_avg;       // EWMA of the time between new packets, ms
+  std::vector<int32_t> jitter;             // EWMA of |interval - interval_avg|, ms
+  std::vector<int16_t> rssi_avg_x16;       // EWMA of RSSI, dBm * 16
+  std::vector<int8_t> last_rssi;           // dBm, RSSI_UNKNOWN if not reported
+
+  size_t add_slot() {
+    size_t slot = this->packets.size();
+    this->packets.push_back(0);
+    this->duplicates.push_back(0);
+    this->decrypt_failures.push_back(0);
+    this->unknown_objects.push_back(0);
+    this->last_seen.push_back(0);
+    this->last_update.push_back(0);
+    this->interval_avg.push_back(0);
+    this->jitter.push_back(0);
+    this->rssi_avg_x16.push_back(0);
+    this->last_rssi.push_back(RSSI_UNKNOWN);
+    return slot;
+  }
+
+  // Any packet from the device's MAC
+  void record_packet(size_t slot, int8_t rssi) {
+    this->packets[slot]++;
+    if (rssi == RSSI_UNKNOWN) {
+      return;
+    }
+    // EWMA with alpha = 1/8, seeded with the first reading
+    int16_t sample = rssi * 16;
+    if (this->last_rssi[slot] == RSSI_UNKNOWN) {
+      this->rssi_avg_x16[slot] = sample;
+    } else {
+      this->rssi_avg_x16[slot] += (sample - this->rssi_avg_x16[slot]) / 8;
+    }
+    this->last_rssi[slot] = rssi;
+  }
+
+  // A new packet passed admission and deduplication
+  void record_update(size_t slot, uint32_t now) {
+    uint32_t previous = this->last_update[slot];
+    this->last_update[slot] = now;
+    if (previous == 0) {
+      return;
+    }
+    // Inter-arrival jitter in the style of RFC 3550: both EWMAs with alpha = 1/16
+    int32_t interval = (int32_t) std::min<uint32_t>(now - previous, INT32_MAX / 2);
+    if (this->interval_avg[slot] == 0) {
+      this->interval_avg[slot] = interval;
+      return;
+    }
+    int32_t deviation = interval - this->interval_avg[slot];
+    this->interval_avg[slot] += deviation / 16;
+    this->jitter[slot] += ((deviation < 0 ? -deviation : deviation) - this->jitter[slot]) / 16;
+  }
+};
+
 // =============================================================================
 // BTHomeDevice - Represents a single BTHome BLE device being monitored
 // =============================================================================
 class BTHomeDevice : public Parented<BTHomeReceiverHub> {
  public:
+  // Outcome of the header-only admission check; reject reasons come first and index reject_counts_
+  enum class AdmitResult : uint8_t {
+    REJECT_LENGTH = 0,  // Empty, oversized, or encrypted without room for counter + MIC
+    REJECT_NO_KEY,      // Encrypted but no encryption key configured
+    REJECT_REPLAY,      // Encrypted with a counter below the replay window
+    ACCEPT,
+    RETRANSMIT,         // Encrypted with a counter already accepted within the replay window
+  };
+
+  // How a counter that jumped back below the replay window (sender reboot) is handled.
+  // Only counters restarted near 0 are considered, and only once they authenticate.
+  enum class ResyncPolicy : uint8_t {
+    STRICT = 0,   // Never: reject until the stored counter is cleared (clear_counter())
+    CONSECUTIVE,  // After resync_packets authenticated packets with increasing counters (default)
+    IMMEDIATE,    // On the first authenticated packet
+  };
+  static constexpr size_t REJECT_REASON_COUNT = 3;
+
+  // Reception statistics that can be published as diagnostic sensors
+  enum class StatSensor : uint8_t {
+    PACKETS = 0,
+    DUPLICATES,
+    DECRYPT_FAILURES,
+    REPLAYS,
+    UNKNOWN_OBJECTS,
+    RSSI,
+    RSSI_AVERAGE,
+    JITTER,
+    LAST_SEEN_AGE,
+  };
+  static constexpr size_t STAT_SENSOR_COUNT = 9;
+
   explicit BTHomeDevice(BTHomeReceiverHub *parent) : Parented(parent) {}
+  ~BTHomeDevice();
 
   void set_mac_address(uint64_t mac) { this->address_ = mac; }
   void set_name(const std::string &name) { this->name_ = name; }
   void set_encryption_key(const std::array<uint8_t, AES_KEY_SIZE> &key);
+  void set_resync_policy(ResyncPolicy policy, uint8_t packets) {
+    this->resync_policy_ = policy;
+    this->resync_packets_ = packets;
+  }
+
+  // Counter persistence: restore the last accepted counter at boot, save it when changed
+  void load_counter();
+  // Returns true if the counter was written
+  bool save_counter();
+  // Forget the replay window and the stored counter, so the next authenticated packet is accepted
+  // whatever its counter (for a sender that restarted its counter under the strict policy)
+  void clear_counter();
 
   uint64_t get_mac_address() const { return this->address_; }
   const std::string &get_name() const { return this->name_; }
+  // Time of the last admitted packet (ms since boot, 0 = never)
+  uint32_t get_last_seen() const { return this->stats_->last_seen[this->stats_slot_]; }
+  bool is_encryption_enabled() const { return this->encryption_enabled_; }
+
+  // Decryption latency statistics (successful and failed auth-decrypt calls)
+  uint32_t get_decrypt_count() const { return this->decrypt_count_; }
+  uint32_t get_decrypt_time_avg_us() const {
+    return this->decrypt_count_ == 0 ? 0 : (uint32_t) (this->decrypt_time_total_us_ / this->decrypt_count_);
+  }
+  uint32_t get_decrypt_time_max_us() const { return this->decrypt_time_max_us_; }
+
+  // Packets rejected by the admission check, per reason
+  uint32_t get_reject_count(AdmitResult reason) const {
+    return static_cast<size_t>(reason) < REJECT_REASON_COUNT ? this->reject_counts_[static_cast<size_t>(reason)] : 0;
+  }
+
+  // Reception statistics row, assigned by the hub in register_device()
+  void set_stats(ReceptionStats *stats, size_t slot) {
+    this->stats_ = stats;
+    this->stats_slot_ = slot;
+  }
+  const ReceptionStats &get_stats() const { return *this->stats_; }
+  size_t get_stats_slot() const { return this->stats_slot_; }
 
-  // Parse incoming BLE advertisement
+  // Parse incoming BLE advertisement (service data without the UUID), received at timestamp (ms since boot)
+  bool parse_advertisement(const uint8_t *service_data, size_t len, int8_t rssi, uint32_t timestamp);
+  bool parse_advertisement(const uint8_t *service_data, size_t len);
   bool parse_advertisement(const std::vector<uint8_t> &service_data);
 
 #ifdef USE_SENSOR
-  void add_sensor(uint8_t object_id, uint8_t index, sensor::Sensor *sensor) {
-    this->sensors_.push_back(new BTHomeSensor(object_id, index, sensor));
-  }
+  // min_interval (ms) and delta rate limit the sensor's publishes, 0 = unlimited
+  void add_sensor(uint8_t object_id, uint8_t index, sensor::Sensor *sensor, uint32_t min_interval = 0,
+                  float delta = 0.0f);
+
+  // Keep the last max_samples values of a sensor added with add_sensor() for window_ms, with
+  // resolution its BTHome factor, and publish their min/max/mean/sum (each sensor optional)
+  void add_sensor_history(uint8_t object_id, uint8_t index, sensor::Sensor *sensor, size_t max_samples,
+                          uint32_t window_ms, float resolution, sensor::Sensor *min_sensor,
+                          sensor::Sensor *max_sensor, sensor::Sensor *mean_sensor, sensor::Sensor *sum_sensor);
+  // Drop samples that left their window and republish the aggregates
+  void expire_histories(uint32_t now);
+
+  void set_stat_sensor(StatSensor stat, sensor::Sensor *sensor);
+  // Publish the configured reception statistics sensors
+  void publish_stat_sensors(uint32_t now);
 #endif
 
 #ifdef USE_BINARY_SENSOR
-  void add_binary_sensor(uint8_t object_id, binary_sensor::BinarySensor *sensor) {
-    this->binary_sensors_.push_back(new BTHomeBinarySensor(object_id, sensor));
-  }
+  void add_binary_sensor(uint8_t object_id, binary_sensor::BinarySensor *sensor);
 #endif
 
 #ifdef USE_TEXT_SENSOR
-  void add_text_sensor(uint8_t object_id, text_sensor::TextSensor *sensor) {
-    this->text_sensors_.push_back(new BTHomeTextSensor(object_id, sensor));
-  }
+  void add_text_sensor(uint8_t object_id, text_sensor::TextSensor *sensor);
 #endif
 
-  void add_button_trigger(BTHomeButtonTrigger *trigger) { this->button_triggers_.push_back(trigger); }
-  void add_dimmer_trigger(BTHomeDimmerTrigger *trigger) { this->dimmer_triggers_.push_back(trigger); }
+  void add_button_trigger(BTHomeButtonTrigger *trigger);
+  void add_dimmer_trigger(BTHomeDimmerTrigger *trigger);
 
  protected:
+  // Validate a packet from its header bytes only (length, encryption flag, counter)
+  AdmitResult admit_packet_(const uint8_t *service_data, size_t len) const;
+
   // Decrypt encrypted payload using AES-128-CCM
-  bool decrypt_payload_(const uint8_t *ciphertext, size_t ciphertext_len, const uint8_t *mac,
-                        uint8_t device_info, uint32_t counter, uint8_t *plaintext, size_t *plaintext_len);
+  bool decrypt_payload_(const bthome_codec::EncryptedFrame &frame, uint8_t *plaintext);
 
   // Parse measurement objects from payload
-  void parse_measurements_(const uint8_t *data, size_t len);
+  void parse_measurements_(const uint8_t *data, size_t len, uint32_t timestamp);
 
-  // Publish values to registered sensors
-  void publish_sensor_value_(uint8_t object_id, uint8_t index, float value);
-  void publish_binary_sensor_value_(uint8_t object_id, bool value);
-  void publish_text_value_(uint8_t object_id, const std::string &value);
+#ifdef USE_SENSOR
+  // Apply the entity's rate limit, then publish now or hand to the hub's batch, together with
+  // the aggregates of its history
+  void publish_sensor_(const DispatchEntry &entry, float value, uint32_t now);
+#endif
+
+  // Insert a subscriber keeping dispatch_table_ sorted by key
+  DispatchEntry &add_dispatch_entry_(uint8_t object_id, uint8_t index);
+
+  // Whether any entity or trigger subscribed to this object ID
+  bool is_subscribed_(uint8_t object_id) const {
+    return (this->subscribed_[object_id >> 5] & (1u << (object_id & 0x1F))) != 0;
+  }
 
-  // Handle events
-  void handle_button_event_(uint8_t button_index, uint8_t event_type);
-  void handle_dimmer_event_(uint8_t dimmer_index, int8_t steps);
+  // Find the subscribers for (object_id, index) as a [first, last) range (binary search)
+  std::pair<const DispatchEntry *, const DispatchEntry *> find_dispatch_entries_(uint8_t object_id,
+                                                                                uint8_t index) const;
 
   uint64_t address_{0};
   std::string name_;
 
-  // Encryption
+  ReceptionStats *stats_{nullptr};
+  size_t stats_slot_{0};
+#ifdef USE_SENSOR
+  // Allocated only when a statistics sensor is configured
+  std::unique_ptr<std::array<sensor::Sensor *, STAT_SENSOR_COUNT>> stat_sensors_;
+#endif
+
+  // Encryption - the CCM context holds the expanded key, set up once in set_encryption_key()
   bool encryption_enabled_{false};
-  std::array<uint8_t, AES_KEY_SIZE> encryption_key_{};
+  bool ccm_ready_{false};
+  mbedtls_ccm_context ccm_ctx_;
+
+  // Replay window in the style of IPsec: highest authenticated counter, plus a bitmap of the
+  // REPLAY_WINDOW_SIZE counters up to it (bit n = counter last_counter_ - n accepted), so
+  // reordered and late packets are accepted once.
+  static constexpr uint32_t REPLAY_WINDOW_SIZE = 64;
+  void mark_counter_(uint32_t counter);
+  // Replayed genuine packets authenticate too, so only counters a freshly booted sender could
+  // use are resync candidates, and their decryption is rate limited per device
+  static constexpr uint32_t RESYNC_MAX_COUNTER = REPLAY_WINDOW_SIZE;
+  static constexpr uint32_t RESYNC_ATTEMPT_INTERVAL_MS = 2000;
+  // Whether a packet below the window is worth decrypting as a resync candidate
+  bool try_resync_(uint32_t counter, uint32_t timestamp);
+  // Whether a counter below the window should resynchronise the window (already authenticated)
+  bool accept_resync_(uint32_t counter);
+  bool counter_valid_{false};
   uint32_t last_counter_{0};
-
-  // Deduplication - store last received service data to skip duplicate packets
-  std::vector<uint8_t> last_service_data_;
-
-  // Sensors
+  uint64_t replay_bitmap_{0};
+  ResyncPolicy resync_policy_{ResyncPolicy::CONSECUTIVE};
+  uint8_t resync_packets_{3};
+  uint8_t resync_count_{0};
+  bool resync_attempted_{false};
+  uint32_t resync_candidate_{0};
+  uint32_t last_resync_attempt_{0};
+
+  ESPPreferenceObject counter_pref_;
+  bool counter_pref_ready_{false};
+  uint32_t saved_counter_{0};
+
+  // Decryption latency statistics
+  uint32_t decrypt_count_{0};
+  uint64_t decrypt_time_total_us_{0};
+  uint32_t decrypt_time_max_us_{0};
+
+  // Admission rejections, indexed by AdmitResult
+  std::array<uint32_t, REJECT_REASON_COUNT> reject_counts_{};
+
+  // Whether an unencrypted packet was already seen; records its key otherwise
+  bool is_duplicate_(const uint8_t *service_data, size_t len);
+
+  // Deduplication of unencrypted packets: keys of the most recent distinct packets, so senders
+  // rotating several advertisements are still recognised. Encrypted packets dedup on the counter.
+  static constexpr size_t DEDUP_WINDOW_SIZE = 8;
+  std::array<uint32_t, DEDUP_WINDOW_SIZE> dedup_keys_{};
+  uint8_t dedup_next_{0};
+  uint8_t dedup_count_{0};
+
+  // Entities and triggers, contiguous and sorted by (object_id, index)
+  std::vector<DispatchEntry> dispatch_table_;
+  // Rate limit state of the entities that configured one, indexed by DispatchEntry::filter
+  std::vector<PublishFilter> publish_filters_;
 #ifdef USE_SENSOR
-  std::vector<BTHomeSensor *> sensors_;
+  // Histories of the sensors that configured one, indexed by DispatchEntry::history
+  std::vector<SensorHistoryEntry> histories_;
 #endif
-#ifdef USE_BINARY_SENSOR
-  std::vector<BTHomeBinarySensor *> binary_sensors_;
-#endif
-#ifdef USE_TEXT_SENSOR
-  std::vector<BTHomeTextSensor *> text_sensors_;
+  // 256-bit bitmap of object IDs present in dispatch_table_
+  std::array<uint32_t, 8> subscribed_{};
+};
+
+#ifdef USE_BTHOME_RECEIVER_NIMBLE
+// =============================================================================
+// AdvertisementQueue - Lock-free hand-off from the NimBLE host task to loop()
+// Single producer (GAP callback) / single consumer (main loop), no heap use.
+// =============================================================================
+struct AdvertisementRecord {
+  uint64_t address;
+  uint32_t timestamp;  // Reception time (ms since boot)
+  int8_t rssi;
+  uint8_t len;
+  uint8_t data[MAX_SERVICE_DATA_SIZE];  // BTHome service data (without UUID)
+};
+
+template<size_t N> class AdvertisementQueue {
+ public:
+  // Producer side - called from the NimBLE host task only
+  bool push(uint64_t address, int8_t rssi, uint32_t timestamp, const uint8_t *data, size_t len) {
+    size_t head = this->head_.load(std::memory_order_relaxed);
+    size_t tail = this->tail_.load(std::memory_order_acquire);
+    if (len > MAX_SERVICE_DATA_SIZE || head - tail >= N) {
+      this->dropped_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+
+    AdvertisementRecord &record = this->records_[head % N];
+    record.address = address;
+    record.timestamp = timestamp;
+    record.rssi = rssi;
+    record.len = len;
+    memcpy(record.data, data, len);
+    this->head_.store(head + 1, std::memory_order_release);
+
+    size_t used = head + 1 - tail;
+    if (used > this->high_water_mark_.load(std::memory_order_relaxed)) {
+      this->high_water_mark_.store(used, std::memory_order_relaxed);
+    }
+    return true;
+  }
+
+  // Consumer side - called from loop() only. Returns nullptr when empty.
+  const AdvertisementRecord *front() const {
+    size_t tail = this->tail_.load(std::memory_order_relaxed);
+    if (tail == this->head_.load(std::memory_order_acquire)) {
+      return nullptr;
+    }
+    return &this->records_[tail % N];
+  }
+  void pop() { this->tail_.store(this->tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+  bool empty() const { return this->front() == nullptr; }
+  constexpr size_t capacity() const { return N; }
+  uint32_t get_dropped() const { return this->dropped_.load(std::memory_order_relaxed); }
+  size_t get_high_water_mark() const { return this->high_water_mark_.load(std::memory_order_relaxed); }
+
+ protected:
+  std::array<AdvertisementRecord, N> records_{};
+  std::atomic<size_t> head_{0};  // Next slot to write (owned by producer)
+  std::atomic<size_t> tail_{0};  // Next slot to read (owned by consumer)
+  std::atomic<uint32_t> dropped_{0};
+  std::atomic<size_t> high_water_mark_{0};
+};
 #endif
 
-  // Event triggers
-  std::vector<BTHomeButtonTrigger *> button_triggers_;
-  std::vector<BTHomeDimmerTrigger *> dimmer_triggers_;
+// =============================================================================
+// DetectedDeviceCache - Last advertisement of every BTHome device in range (discovery mode)
+// Fixed capacity with least-recently-seen eviction, so rotating random addresses
+// cannot grow it. Lookup is a hash of the MAC into chained buckets.
+// =============================================================================
+struct DetectedDevice {
+  uint64_t address;
+  uint32_t last_seen;  // ms since boot
+  uint8_t len;
+  uint8_t data[MAX_SERVICE_DATA_SIZE];  // BTHome service data (without UUID)
+};
+
+template<size_t N> class DetectedDeviceCache {
+  static_assert(N > 0 && N < 0xFFFF, "Detected device cache size must fit a 16-bit index");
+
+ public:
+  DetectedDeviceCache() { this->buckets_.fill(NONE); }
+
+  // Store the latest service data of a device, evicting the least recently seen one when full
+  void update(uint64_t address, uint32_t now, const uint8_t *data, size_t len) {
+    uint16_t index = this->find_(address);
+    if (index == NONE) {
+      if (this->size_ < N) {
+        index = this->size_++;
+      } else {
+        index = this->lru_tail_;
+        this->unlink_bucket_(index);
+        this->unlink_lru_(index);
+        this->evictions_++;
+      }
+      this->entries_[index].address = address;
+      this->link_bucket_(index);
+    } else {
+      this->unlink_lru_(index);
+    }
+    this->link_lru_front_(index);
+
+    DetectedDevice &device = this->entries_[index];
+    device.last_seen = now;
+    device.len = len < MAX_SERVICE_DATA_SIZE ? len : MAX_SERVICE_DATA_SIZE;
+    memcpy(device.data, data, device.len);
+  }
+
+  // Visit cached devices, most recently seen first
+  template<typename F> void for_each(F &&callback) const {
+    for (uint16_t i = this->lru_head_; i != NONE; i = this->links_[i].lru_next) {
+      callback(this->entries_[i]);
+    }
+  }
+
+  size_t size() const { return this->size_; }
+  constexpr size_t capacity() const { return N; }
+  uint32_t get_evictions() const { return this->evictions_; }
+
+ protected:
+  static constexpr uint16_t NONE = 0xFFFF;
+
+  // Power-of-two bucket count >= N (at least 2) for multiplicative hashing
+  static constexpr size_t bucket_bits_(size_t n) { return n <= 2 ? 1 : 1 + bucket_bits_((n + 1) / 2); }
+  static constexpr size_t BUCKET_BITS = bucket_bits_(N);
+
+  struct Links {
+    uint16_t lru_prev;
+    uint16_t lru_next;
+    uint16_t bucket_next;
+  };
+
+  static size_t bucket_of_(uint64_t address) {
+    return static_cast<size_t>((address * 0x9E3779B97F4A7C15ULL) >> (64 - BUCKET_BITS));
+  }
+
+  uint16_t find_(uint64_t address) const {
+    for (uint16_t i = this->buckets_[bucket_of_(address)]; i != NONE; i = this->links_[i].bucket_next) {
+      if (this->entries_[i].address == address) {
+        return i;
+      }
+    }
+    return NONE;
+  }
+
+  void link_bucket_(uint16_t index) {
+    size_t bucket = bucket_of_(this->entries_[index].address);
+    this->links_[index].bucket_next = this->buckets_[bucket];
+    this->buckets_[bucket] = index;
+  }
+
+  void unlink_bucket_(uint16_t index) {
+    uint16_t *link = &this->buckets_[bucket_of_(this->entries_[index].address)];
+    while (*link != index) {
+      link = &this->links_[*link].bucket_next;
+    }
+    *link = this->links_[index].bucket_next;
+  }
+
+  void link_lru_front_(uint16_t index) {
+    this->links_[index].lru_prev = NONE;
+    this->links_[index].lru_next = this->lru_head_;
+    if (this->lru_head_ != NONE) {
+      this->links_[this->lru_head_].lru_prev = index;
+    } else {
+      this->lru_tail_ = index;
+    }
+    this->lru_head_ = index;
+  }
+
+  void unlink_lru_(uint16_t index) {
+    const Links &links = this->links_[index];
+    if (links.lru_prev != NONE) {
+      this->links_[links.lru_prev].lru_next = links.lru_next;
+    } else {
+      this->lru_head_ = links.lru_next;
+    }
+    if (links.lru_next != NONE) {
+      this->links_[links.lru_next].lru_prev = links.lru_prev;
+    } else {
+      this->lru_tail_ = links.lru_prev;
+    }
+  }
+
+  std::array<DetectedDevice, N> entries_{};
+  std::array<Links, N> links_{};
+  std::array<uint16_t, (size_t) 1 << BUCKET_BITS> buckets_;
+  uint16_t lru_head_{NONE};  // Most recently seen
+  uint16_t lru_tail_{NONE};  // Least recently seen, evicted first
+  uint16_t size_{0};
+  uint32_t evictions_{0};
 };
 
 // =============================================================================
@@ -266,6 +660,33 @@ class BTHomeReceiverHub : public Component {
 
   // Set interval for periodic dump of all detected devices (in ms, 0 = disabled)
   void set_dump_interval(uint32_t interval) { this->dump_interval_ = interval; }
+  // Collect decoded values and publish them in the next loop() pass, skipping unchanged values
+  void set_batch_publish(bool batch_publish) { this->batch_publish_ = batch_publish; }
+  bool is_batch_publish() const { return this->batch_publish_; }
+  // Queue an entity once per pass; a later value for the same entity replaces the earlier one.
+  // A sensor's history aggregates, if given, are published in the same pass.
+  void defer_publish(const DispatchEntry *entry, ObjectKind kind, float value,
+                     const SensorHistoryEntry *history = nullptr) {
+    entry->pending_value = value;
+    if (entry->pending) {
+      return;
+    }
+    entry->pending = true;
+    this->pending_publishes_.push_back({entry, kind, history});
+    this->enable_loop();
+  }
+
+  // Replay protection for encrypted devices, applied to all devices in setup()
+  void set_resync_policy(BTHomeDevice::ResyncPolicy policy, uint8_t packets) {
+    this->resync_policy_ = policy;
+    this->resync_packets_ = packets;
+  }
+  // Save changed counters at most this often (in ms, 0 = no persistence)
+  void set_counter_persist_interval(uint32_t interval) { this->counter_persist_interval_ = interval; }
+  void on_shutdown() override;
+
+  // Set interval for publishing per-device reception statistics sensors (in ms)
+  void set_stats_interval(uint32_t interval) { this->stats_interval_ = interval; }
 
 #ifdef USE_BTHOME_RECEIVER_BLUEDROID
   // ESPBTDeviceListener interface - called when BLE advertisement is received
@@ -273,31 +694,75 @@ class BTHomeReceiverHub : public Component {
 #endif
 
 #ifdef USE_BTHOME_RECEIVER_NIMBLE
-  // Process advertisement received via NimBLE
+  // Extract BTHome service data from a NimBLE advertisement and queue it for loop()
+  // Runs in the NimBLE host task - must not touch devices or sensors
   void process_nimble_advertisement(const struct ble_gap_disc_desc *disc);
+
+  // Advertisement queue statistics (for sizing queue_size)
+  uint32_t get_queue_dropped() const { return this->adv_queue_.get_dropped(); }
+  size_t get_queue_high_water_mark() const { return this->adv_queue_.get_high_water_mark(); }
+
+  // Scan interval and window in 0.625 ms units (window <= interval)
+  void set_scan_parameters(uint16_t interval, uint16_t window) {
+    this->scan_interval_ = interval;
+    this->scan_window_base_ = window;
+    this->scan_window_ = window;
+  }
+  // Widen the scan window while a registered device has not been heard for overdue_timeout ms,
+  // up to ten times that long
+  void set_scan_adaptive(uint32_t overdue_timeout) {
+    this->scan_adaptive_ = true;
+    this->scan_overdue_timeout_ = overdue_timeout;
+  }
+
+  // Program the controller's filter accept list with the registered device addresses so
+  // other advertisers never reach the host. Ignored while dump_interval discovery is on.
+  void set_filter_accept_list(bool enabled) { this->filter_accept_list_ = enabled; }
+  bool is_filter_accept_list_active() const { return this->filter_active_; }
+
+  // Scan statistics over the last measurement period
+  float get_scan_duty_cycle() const { return this->scan_duty_cycle_; }  // Percent of time scanning
+  float get_advertisements_per_second() const { return this->adv_per_second_; }  // All advertisers, host side
 #endif
 
+  // Detected device cache statistics (for sizing detected_cache_size)
+  size_t get_detected_device_count() const { return this->detected_devices_.size(); }
+  uint32_t get_detected_device_evictions() const { return this->detected_devices_.get_evictions(); }
+
  protected:
-  // Device registry - using vector for small dataset optimization (typically <10 devices)
+  // Device registry, kept sorted by MAC address at registration time.
+  // device_macs_ mirrors devices_ so lookups binary-search a contiguous key array.
+  // Several devices may share a MAC (hub `devices:` entry plus per-platform entries).
+  std::vector<uint64_t> device_macs_;
   std::vector<BTHomeDevice *> devices_;
 
   // Periodic dump interval (ms, 0 = disabled)
   uint32_t dump_interval_{0};
-  uint32_t last_dump_time_{0};
+  uint32_t stats_interval_{60000};
+  BTHomeDevice::ResyncPolicy resync_policy_{BTHomeDevice::ResyncPolicy::CONSECUTIVE};
+  uint8_t resync_packets_{3};
+  uint32_t counter_persist_interval_{300000};
+  void persist_counters_();
 
-  // Cache of detected BTHome devices for periodic dump
-  // Stores: MAC address -> (last_data, last_seen_time)
-  struct DetectedDevice {
-    std::vector<uint8_t> last_data;
-    uint32_t last_seen{0};
-  };
-  std::vector<std::pair<uint64_t, DetectedDevice>> detected_devices_;
+  // Per-device reception statistics, one row per registered device
+  ReceptionStats reception_stats_;
+
+  // Batch publishing: values decoded since the last loop(), published together
+  void flush_pending_publishes_();
+  bool batch_publish_{false};
+  std::vector<PendingPublish> pending_publishes_;
+
+  // Last advertisement of each detected BTHome device, for the periodic dump
+  DetectedDeviceCache<BTHOME_RECEIVER_DETECTED_CACHE_SIZE> detected_devices_;
+
+  // Handle BTHome service data from either BLE stack (main loop context)
+  bool handle_service_data_(uint64_t address, const uint8_t *data, size_t len, int8_t rssi, uint32_t timestamp);
 
   // Dump an advertisement to the log (for discovery mode)
   void dump_advertisement_(uint64_t address, const uint8_t *data, size_t len);
 
-  // Find a device by MAC address (linear search, efficient for small datasets)
-  BTHomeDevice *find_device_(uint64_t address);
+  // Find the index range of devices registered for a MAC address (binary search)
+  std::pair<size_t, size_t> find_devices_(uint64_t address) const;
 
   // Cache device data for periodic dump
   void cache_device_data_(uint64_t address, const uint8_t *data, size_t len);
@@ -308,18 +773,61 @@ class BTHomeReceiverHub : public Component {
 #ifdef USE_BTHOME_RECEIVER_NIMBLE
   // NimBLE-specific members
   bool nimble_initialized_{false};
-  bool init_attempted_{false};
   bool scanning_{false};
+  AdvertisementQueue<BTHOME_RECEIVER_QUEUE_SIZE> adv_queue_;
+  uint32_t last_reported_dropped_{0};
+  uint32_t last_drop_log_time_{0};
+  void drain_advertisement_queue_();
   static BTHomeReceiverHub *instance_;  // For NimBLE callbacks
   static void nimble_host_task_(void *param);
   static void nimble_on_sync_();
   static void nimble_on_reset_(int reason);
   static int nimble_gap_event_(struct ble_gap_event *event, void *arg);
+  // Called on the host task when the stack ends the scan; the scan scheduler restarts it
+  void note_scan_ended_();
   void init_nimble_();
   void start_scanning_();
   void stop_scanning_();
+
+  // Scan scheduling
+  void update_scan_scheduler_(uint32_t now);
+  void account_scan_time_(uint32_t now);
+  uint16_t scan_interval_{160};      // 0.625 ms units (100 ms)
+  uint16_t scan_window_base_{80};    // Configured window, 0.625 ms units (50 ms)
+  uint16_t scan_window_{80};         // Current window, widened by the adaptive scheduler
+  uint16_t scan_window_active_{80};  // Window of the running scan
+  bool scan_adaptive_{false};
+  uint32_t scan_overdue_timeout_{60000};
+  uint32_t scan_scheduler_start_{0};  // First scheduler pass; never-heard devices are silent since then
+  uint32_t last_scan_adapt_time_{0};
+  std::atomic<bool> scan_ended_{false};      // Set on the host task when the stack ends the scan
+  std::atomic<uint32_t> scan_end_time_{0};
+
+  // Scan statistics: advertisements counted in the host task, rates on a timer
+  std::atomic<uint32_t> adv_received_{0};
+  uint32_t scan_stats_start_{0};
+  uint32_t scan_stats_adv_count_{0};
+  uint32_t scan_time_checkpoint_{0};  // Scan time before this is in scan_on_ms_
+  float scan_on_ms_{0};  // Radio time scanning since scan_stats_start_: running time × window / interval
+  float scan_duty_cycle_{0};
+  float adv_per_second_{0};
+
+  // Filter accept list: the first stats period scans unfiltered to measure the baseline rate
+  bool apply_filter_accept_list_();
+  bool filter_accept_list_{false};
+  bool filter_active_{false};
+  bool filter_reported_{false};
+  float unfiltered_adv_per_second_{0};
 #endif
 };
 
+// =============================================================================
+// ClearCounterAction - Forget a device's replay window and stored counter
+// =============================================================================
+template<typename... Ts> class ClearCounterAction : public Action<Ts...>, public Parented<BTHomeDevice> {
+ public:
+  void play(const Ts &...x) override { this->parent_->clear_counter(); }
+};
+
 }  // namespace bthome_receiver
 }  // namespace esphome
@@ -19,18 +19,22 @@ from esphome.const import (
     DEVICE_CLASS_ILLUMINANCE,
     DEVICE_CLASS_POWER,
     DEVICE_CLASS_PRESSURE,
+    DEVICE_CLASS_SIGNAL_STRENGTH,
     DEVICE_CLASS_SPEED,
     DEVICE_CLASS_TEMPERATURE,
     DEVICE_CLASS_VOLTAGE,
+    ENTITY_CATEGORY_DIAGNOSTIC,
     STATE_CLASS_MEASUREMENT,
     STATE_CLASS_TOTAL_INCREASING,
     UNIT_AMPERE,
     UNIT_CELSIUS,
+    UNIT_DECIBEL_MILLIWATT,
     UNIT_DEGREES,
     UNIT_KILOGRAM,
     UNIT_KILOWATT_HOURS,
     UNIT_LUX,
     UNIT_METER,
+    UNIT_MILLISECOND,
     UNIT_MILLIMETER,
     UNIT_MICROGRAMS_PER_CUBIC_METER,
     UNIT_PARTS_PER_MILLION,
@@ -56,6 +60,38 @@ DEPENDENCIES = ["bthome_receiver"]
 
 # Configuration key for sensor index (for multiple sensors of same type)
 CONF_INDEX = "index"
+# Per-entity publish rate limiting
+CONF_MIN_PUBLISH_INTERVAL = "min_publish_interval"
+CONF_PUBLISH_DELTA = "publish_delta"
+# Per-entity time-series history and its aggregate sensors
+CONF_HISTORY = "history"
+CONF_WINDOW = "window"
+CONF_MAX_SAMPLES = "max_samples"
+HISTORY_AGGREGATES = ("min", "max", "mean", "sum")
+# Samples store the time since the previous one in 16-bit seconds
+MAX_HISTORY_WINDOW = cv.TimePeriod(seconds=65535)
+
+StatSensor = BTHomeDevice.enum("StatSensor", True)
+
+# Per-device reception statistics, published every stats_interval of the hub
+# Format: key: (StatSensor, device_class, unit_of_measurement, state_class, accuracy_decimals)
+STAT_SENSORS = {
+    "packets_received": (StatSensor.PACKETS, None, None, STATE_CLASS_TOTAL_INCREASING, 0),
+    "duplicates_dropped": (StatSensor.DUPLICATES, None, None, STATE_CLASS_TOTAL_INCREASING, 0),
+    "decrypt_failures": (StatSensor.DECRYPT_FAILURES, None, None, STATE_CLASS_TOTAL_INCREASING, 0),
+    "replay_rejects": (StatSensor.REPLAYS, None, None, STATE_CLASS_TOTAL_INCREASING, 0),
+    "unknown_objects": (StatSensor.UNKNOWN_OBJECTS, None, None, STATE_CLASS_TOTAL_INCREASING, 0),
+    "rssi": (StatSensor.RSSI, DEVICE_CLASS_SIGNAL_STRENGTH, UNIT_DECIBEL_MILLIWATT, STATE_CLASS_MEASUREMENT, 0),
+    "rssi_average": (
+        StatSensor.RSSI_AVERAGE,
+        DEVICE_CLASS_SIGNAL_STRENGTH,
+        UNIT_DECIBEL_MILLIWATT,
+        STATE_CLASS_MEASUREMENT,
+        1,
+    ),
+    "jitter": (StatSensor.JITTER, DEVICE_CLASS_DURATION, UNIT_MILLISECOND, STATE_CLASS_MEASUREMENT, 0),
+    "last_seen_age": (StatSensor.LAST_SEEN_AGE, DEVICE_CLASS_DURATION, UNIT_SECOND, STATE_CLASS_MEASUREMENT, 0),
+}
 
 # Map sensor type names to their metadata for ESPHome integration
 # Format: type_name: (device_class, unit_of_measurement, state_class, accuracy_decimals)
@@ -148,9 +184,24 @@ def sensor_schema(sensor_type):
     if state_class:
         schema_kwargs["state_class"] = state_class
 
+    # Aggregates share the unit and device class of the sensor
+    history_schema = cv.All(
+        cv.Schema({
+            cv.Optional(CONF_WINDOW, default="1h"): cv.All(
+                cv.positive_time_period_milliseconds, cv.Range(max=MAX_HISTORY_WINDOW)
+            ),
+            cv.Optional(CONF_MAX_SAMPLES, default=120): cv.int_range(min=2, max=65535),
+            **{cv.Optional(aggregate): sensor.sensor_schema(**schema_kwargs) for aggregate in HISTORY_AGGREGATES},
+        }),
+        cv.has_at_least_one_key(*HISTORY_AGGREGATES),
+    )
+
     # Base sensor schema with optional index
     base_schema = sensor.sensor_schema(**schema_kwargs).extend({
         cv.Optional(CONF_INDEX, default=0): cv.int_range(min=0, max=255),
+        cv.Optional(CONF_MIN_PUBLISH_INTERVAL): cv.positive_time_period_milliseconds,
+        cv.Optional(CONF_PUBLISH_DELTA): cv.positive_float,
+        cv.Optional(CONF_HISTORY): history_schema,
     })
 
     # Allow either single config or list of configs
@@ -171,6 +222,18 @@ for _sensor_type in SENSOR_TYPES.keys():
     if _schema:
         _schema_dict[cv.Optional(_sensor_type)] = _schema
 
+for _stat, (_, _device_class, _unit, _state_class, _decimals) in STAT_SENSORS.items():
+    _stat_kwargs = {
+        "accuracy_decimals": _decimals,
+        "state_class": _state_class,
+        "entity_category": ENTITY_CATEGORY_DIAGNOSTIC,
+    }
+    if _device_class:
+        _stat_kwargs["device_class"] = _device_class
+    if _unit:
+        _stat_kwargs["unit_of_measurement"] = _unit
+    _schema_dict[cv.Optional(_stat)] = sensor.sensor_schema(**_stat_kwargs)
+
 CONFIG_SCHEMA = cv.Schema(_schema_dict)
 
 
@@ -207,8 +270,40 @@ async def to_code(config):
                 # Create the ESPHome sensor
                 sens = await sensor.new_sensor(sensor_config)
 
-                # Register sensor with device (object_id, index, sensor*)
-                cg.add(device_var.add_sensor(object_id, index, sens))
+                # Register sensor with device (object_id, index, sensor*[, min_interval, delta])
+                if CONF_MIN_PUBLISH_INTERVAL in sensor_config or CONF_PUBLISH_DELTA in sensor_config:
+                    min_interval = sensor_config.get(CONF_MIN_PUBLISH_INTERVAL, 0)
+                    delta = sensor_config.get(CONF_PUBLISH_DELTA, 0.0)
+                    cg.add(device_var.add_sensor(object_id, index, sens, min_interval, delta))
+                else:
+                    cg.add(device_var.add_sensor(object_id, index, sens))
+
+                # Time-series history, quantised to the object's BTHome factor
+                if CONF_HISTORY in sensor_config:
+                    history = sensor_config[CONF_HISTORY]
+                    aggregates = []
+                    for aggregate in HISTORY_AGGREGATES:
+                        if aggregate in history:
+                            aggregates.append(await sensor.new_sensor(history[aggregate]))
+                        else:
+                            aggregates.append(cg.nullptr)
+                    cg.add(
+                        device_var.add_sensor_history(
+                            object_id,
+                            index,
+                            sens,
+                            history[CONF_MAX_SAMPLES],
+                            history[CONF_WINDOW],
+                            type_info[3],
+                            *aggregates,
+                        )
+                    )
+
+    # Register reception statistics sensors
+    for stat, stat_info in STAT_SENSORS.items():
+        if stat in config:
+            sens = await sensor.new_sensor(config[stat])
+            cg.add(device_var.set_stat_sensor(stat_info[0], sens))
 
     # Register device with hub
     cg.add(hub.register_device(device_var))
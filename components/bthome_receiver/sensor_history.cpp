@@ -0,0 +1,157 @@
+#include "sensor_history.h"
+#include "esphome/core/helpers.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <initializer_list>
+
+namespace esphome {
+namespace bthome_receiver {
+
+SensorHistory::~SensorHistory() {
+  if (this->slots_ != nullptr) {
+    RAMAllocator<Slot>().deallocate(this->slots_, this->capacity_);
+    RAMAllocator<Extreme>().deallocate(this->min_queue_.items, this->capacity_);
+    RAMAllocator<Extreme>().deallocate(this->max_queue_.items, this->capacity_);
+  }
+}
+
+bool SensorHistory::init(size_t max_samples, uint32_t window_ms, float resolution) {
+  // An escaped sample takes two slots, so at least two are needed
+  this->capacity_ = max_samples < 2 ? 2 : max_samples;
+  this->window_ms_ = window_ms < MAX_WINDOW_MS ? window_ms : MAX_WINDOW_MS;
+  this->resolution_ = resolution > 0.0f ? resolution : 1.0f;
+
+  // RAMAllocator prefers PSRAM and falls back to internal RAM
+  this->slots_ = RAMAllocator<Slot>().allocate(this->capacity_);
+  this->min_queue_.items = RAMAllocator<Extreme>().allocate(this->capacity_);
+  this->max_queue_.items = RAMAllocator<Extreme>().allocate(this->capacity_);
+  if (this->slots_ == nullptr || this->min_queue_.items == nullptr || this->max_queue_.items == nullptr) {
+    RAMAllocator<Slot>().deallocate(this->slots_, this->capacity_);
+    RAMAllocator<Extreme>().deallocate(this->min_queue_.items, this->capacity_);
+    RAMAllocator<Extreme>().deallocate(this->max_queue_.items, this->capacity_);
+    this->slots_ = nullptr;
+    this->capacity_ = 0;
+    return false;
+  }
+  return true;
+}
+
+int32_t SensorHistory::read_raw_(size_t index) const {
+  int32_t raw;
+  memcpy(&raw, &this->slots_[index % this->capacity_], sizeof(raw));
+  return raw;
+}
+
+void SensorHistory::write_raw_(size_t index, int32_t raw) {
+  memcpy(&this->slots_[index % this->capacity_], &raw, sizeof(raw));
+}
+
+void SensorHistory::add(uint32_t now, float value) {
+  if (this->slots_ == nullptr || std::isnan(value)) {
+    return;
+  }
+  this->expire(now);
+
+  // Clamp before converting: a uint32 BTHome value can exceed the int32 range
+  float scaled = value / this->resolution_;
+  int32_t raw = scaled >= 2147483520.0f ? INT32_MAX : scaled <= -2147483648.0f ? INT32_MIN : (int32_t) lroundf(scaled);
+  uint16_t dt = 0;
+  // 64 bits: two clamped samples at either end of the int32 range differ by more than int32 holds
+  int64_t dv = 0;
+  if (this->count_ > 0) {
+    // expire() keeps the gap within the window, which fits 16 bits of seconds
+    dt = (uint16_t) std::min<uint32_t>((now - this->back_time_) / 1000, UINT16_MAX);
+    dv = (int64_t) raw - this->back_raw_;
+  }
+  bool escaped = dv <= ESCAPE || dv > INT16_MAX;
+  size_t width = escaped ? 2 : 1;
+  while (this->used_ + width > this->capacity_) {
+    this->pop_front_();
+  }
+
+  if (this->count_ == 0) {
+    // The oldest sample's value and time live in front_*; its slot content is not read
+    this->front_time_ = this->back_time_ = now;
+    this->front_raw_ = raw;
+    this->head_ = 0;
+  } else {
+    // Advance by whole seconds so replaying the deltas reproduces back_time_ exactly
+    this->back_time_ += dt * 1000u;
+  }
+  size_t tail = (this->head_ + this->used_) % this->capacity_;
+  this->slots_[tail] = {dt, escaped ? ESCAPE : (int16_t) dv};
+  if (escaped) {
+    this->write_raw_(tail + 1, raw);
+  }
+  this->used_ += width;
+
+  uint32_t seq = this->front_seq_ + this->count_;
+  this->count_++;
+  this->back_raw_ = raw;
+  this->sum_raw_ += raw;
+  this->push_extreme_(this->min_queue_, seq, raw, true);
+  this->push_extreme_(this->max_queue_, seq, raw, false);
+}
+
+void SensorHistory::push_extreme_(ExtremeQueue &queue, uint32_t seq, int32_t raw, bool is_min) {
+  // Drop values that can no longer be the extreme while this newer sample is in the window
+  while (queue.len > 0) {
+    const Extreme &back = queue.items[(queue.head + queue.len - 1) % this->capacity_];
+    if (is_min ? back.raw < raw : back.raw > raw) {
+      break;
+    }
+    queue.len--;
+  }
+  queue.items[(queue.head + queue.len) % this->capacity_] = {seq, raw};
+  queue.len++;
+}
+
+void SensorHistory::expire(uint32_t now) {
+  while (this->count_ > 0 && now - this->front_time_ > this->window_ms_) {
+    this->pop_front_();
+  }
+}
+
+void SensorHistory::pop_front_() {
+  this->sum_raw_ -= this->front_raw_;
+  for (ExtremeQueue *queue : {&this->min_queue_, &this->max_queue_}) {
+    if (queue->len > 0 && queue->items[queue->head].seq == this->front_seq_) {
+      queue->head = (queue->head + 1) % this->capacity_;
+      queue->len--;
+    }
+  }
+
+  size_t width = this->slot_width_(this->head_);
+  this->head_ = (this->head_ + width) % this->capacity_;
+  this->used_ -= width;
+  this->count_--;
+  this->front_seq_++;
+  if (this->count_ == 0) {
+    this->used_ = 0;
+    return;
+  }
+
+  // Replay the next sample's delta onto the front
+  const Slot &next = this->slots_[this->head_];
+  this->front_time_ += next.dt * 1000u;
+  this->front_raw_ = next.dv == ESCAPE ? this->read_raw_(this->head_ + 1) : this->front_raw_ + next.dv;
+}
+
+float SensorHistory::get_min() const {
+  return this->count_ == 0 ? NAN : this->min_queue_.items[this->min_queue_.head].raw * this->resolution_;
+}
+
+float SensorHistory::get_max() const {
+  return this->count_ == 0 ? NAN : this->max_queue_.items[this->max_queue_.head].raw * this->resolution_;
+}
+
+float SensorHistory::get_sum() const { return this->count_ == 0 ? NAN : this->sum_raw_ * this->resolution_; }
+
+float SensorHistory::get_mean() const {
+  return this->count_ == 0 ? NAN : (float) this->sum_raw_ / this->count_ * this->resolution_;
+}
+
+}  // namespace bthome_receiver
+}  // namespace esphome
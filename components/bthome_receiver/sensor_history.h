@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace bthome_receiver {
+
+// =============================================================================
+// SensorHistory - Time-windowed ring buffer of one received sensor's values
+// Samples are stored as deltas to the previous sample: 16-bit seconds and a 16-bit
+// change in the value's BTHome resolution (a second slot holds the full value when
+// the change does not fit). Sum is kept incrementally and min/max with monotonic
+// queues, so every aggregate is O(1) and adding a sample is amortised O(1).
+// Storage is allocated once, from PSRAM when available.
+// =============================================================================
+class SensorHistory {
+ public:
+  // Longest window the 16-bit time deltas can cover
+  static constexpr uint32_t MAX_WINDOW_MS = 65535u * 1000u;
+
+  ~SensorHistory();
+
+  // max_samples: samples kept (oldest dropped when full), window_ms: age limit,
+  // resolution: value quantum, the factor of the BTHome object. Returns false if out of memory.
+  bool init(size_t max_samples, uint32_t window_ms, float resolution);
+
+  // Record a value received at now (ms since boot); also drops samples older than the window
+  void add(uint32_t now, float value);
+  // Drop samples older than the window
+  void expire(uint32_t now);
+
+  size_t size() const { return this->count_; }
+  // Aggregates over the samples in the window, NAN when empty
+  float get_min() const;
+  float get_max() const;
+  float get_sum() const;
+  float get_mean() const;
+
+ protected:
+  static constexpr int16_t ESCAPE = INT16_MIN;  // dv marker: the full value follows in the next slot
+
+  // Either a delta sample or, after an ESCAPE, the full raw value
+  struct Slot {
+    uint16_t dt;  // Seconds since the previous sample
+    int16_t dv;   // Change from the previous sample, in units of resolution
+  };
+
+  // Sample (by sequence number) that is currently the min or max of a suffix of the window
+  struct Extreme {
+    uint32_t seq;
+    int32_t raw;
+  };
+
+  // Bounded deque of Extreme over a fixed array
+  struct ExtremeQueue {
+    Extreme *items{nullptr};
+    size_t head{0};
+    size_t len{0};
+  };
+
+  void pop_front_();
+  size_t slot_width_(size_t index) const { return this->slots_[index].dv == ESCAPE ? 2 : 1; }
+  int32_t read_raw_(size_t index) const;
+  void write_raw_(size_t index, int32_t raw);
+  void push_extreme_(ExtremeQueue &queue, uint32_t seq, int32_t raw, bool is_min);
+
+  Slot *slots_{nullptr};
+  size_t capacity_{0};  // Slots, and the most samples the extreme queues can hold
+  size_t head_{0};      // Slot of the oldest sample
+  size_t used_{0};      // Slots in use
+  size_t count_{0};     // Samples in the window
+  uint32_t window_ms_{0};
+  float resolution_{1.0f};
+
+  // Absolute time and value of the oldest and newest sample; the slots only hold deltas
+  uint32_t front_time_{0};
+  uint32_t back_time_{0};
+  int32_t front_raw_{0};
+  int32_t back_raw_{0};
+  uint32_t front_seq_{0};  // Sequence number of the oldest sample
+  int64_t sum_raw_{0};
+
+  ExtremeQueue min_queue_;  // Increasing raw values, front is the minimum
+  ExtremeQueue max_queue_;  // Decreasing raw values, front is the maximum
+};
+
+}  // namespace bthome_receiver
+}  // namespace esphome
@@ -14,7 +14,6 @@ from . import (
     bthome_receiver_ns,
     BTHomeReceiverHub,
     BTHomeDevice,
-    BTHomeTextSensor,
     CONF_ENCRYPTION_KEY,
     validate_encryption_key,
 )
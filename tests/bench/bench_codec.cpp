@@ -0,0 +1,73 @@
+// Benchmarks for the platform-free BTHome v2 codec: the per-packet work outside AES-CCM
+
+#include "bthome_codec.h"
+#include "payloads.h"
+
+#include <benchmark/benchmark.h>
+
+using namespace esphome::bthome_codec;
+using bthome_bench::WEATHER_PAYLOAD;
+
+static void BM_ObjectReaderFrame(benchmark::State &state) {
+  for (auto _ : state) {
+    ObjectReader reader(WEATHER_PAYLOAD, sizeof(WEATHER_PAYLOAD));
+    Object object;
+    size_t objects = 0;
+    while (reader.next(object) == ReadResult::OK) {
+      objects++;
+    }
+    benchmark::DoNotOptimize(objects);
+  }
+  state.SetBytesProcessed(state.iterations() * sizeof(WEATHER_PAYLOAD));
+}
+BENCHMARK(BM_ObjectReaderFrame);
+
+static void BM_ObjectReaderDecode(benchmark::State &state) {
+  for (auto _ : state) {
+    ObjectReader reader(WEATHER_PAYLOAD, sizeof(WEATHER_PAYLOAD));
+    Object object;
+    float sum = 0;
+    while (reader.next(object) == ReadResult::OK) {
+      if (object.type->kind == ObjectKind::SENSOR) {
+        sum += decode_value(*object.type, object.data);
+      }
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetBytesProcessed(state.iterations() * sizeof(WEATHER_PAYLOAD));
+}
+BENCHMARK(BM_ObjectReaderDecode);
+
+static void BM_EncodeValue(benchmark::State &state) {
+  uint8_t out[8];
+  float value = 21.37f;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(value);
+    benchmark::DoNotOptimize(encode_value(out, sizeof(out), 0x02, 2, true, 0.01f, value));
+    benchmark::ClobberMemory();
+  }
+}
+BENCHMARK(BM_EncodeValue);
+
+static void BM_SplitEncryptedFrame(benchmark::State &state) {
+  uint8_t service_data[1 + sizeof(WEATHER_PAYLOAD) + COUNTER_SIZE + MIC_SIZE] = {BTHOME_DEVICE_INFO_ENCRYPTED};
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(service_data);
+    EncryptedFrame frame;
+    benchmark::DoNotOptimize(split_encrypted_frame(service_data, sizeof(service_data), frame));
+    benchmark::DoNotOptimize(frame);
+  }
+}
+BENCHMARK(BM_SplitEncryptedFrame);
+
+static void BM_BuildNonce(benchmark::State &state) {
+  uint8_t mac[6];
+  uint8_t nonce[NONCE_SIZE];
+  uint32_t counter = 0;
+  for (auto _ : state) {
+    mac_to_bytes(0x5448E68F80A5ULL, mac);
+    build_nonce(nonce, mac, BTHOME_DEVICE_INFO_ENCRYPTED, counter++);
+    benchmark::DoNotOptimize(nonce);
+  }
+}
+BENCHMARK(BM_BuildNonce);
@@ -0,0 +1,129 @@
+// Encrypted packet decryption: one AES-CCM context per device keyed once (as BTHomeDevice does
+// since set_encryption_key() expands the key) against setting the key up for every packet, at
+// 1, 16 and 128 encrypted devices receiving packets in turn.
+//
+// The firmware uses mbedtls; the host build has OpenSSL, whose EVP API splits the same way:
+// initialising with a key runs the key expansion, re-initialising with only a nonce does not.
+
+#include "bthome_codec.h"
+#include "payloads.h"
+
+#include <benchmark/benchmark.h>
+#include <openssl/evp.h>
+
+#include <array>
+#include <cstdlib>
+#include <vector>
+
+using namespace esphome::bthome_codec;
+using bthome_bench::WEATHER_PAYLOAD;
+
+namespace {
+
+struct Packet {
+  std::array<uint8_t, AES_KEY_SIZE> key;
+  std::vector<uint8_t> service_data;  // device_info + ciphertext + counter + MIC
+  uint8_t nonce[NONCE_SIZE];
+  EncryptedFrame frame;
+  EVP_CIPHER_CTX *cached_ctx;
+};
+
+void check(int ok) {
+  if (ok <= 0) {
+    std::abort();
+  }
+}
+
+std::vector<Packet> make_packets(size_t devices) {
+  std::vector<Packet> packets(devices);
+  for (size_t i = 0; i < devices; i++) {
+    Packet &packet = packets[i];
+    for (size_t j = 0; j < AES_KEY_SIZE; j++) {
+      packet.key[j] = uint8_t(i * 31 + j);
+    }
+    uint8_t mac[6];
+    mac_to_bytes(0x5448E68F8000ULL + i, mac);
+    build_nonce(packet.nonce, mac, BTHOME_DEVICE_INFO_ENCRYPTED, uint32_t(i));
+
+    // Encrypt the weather station payload as the device would
+    const size_t len = sizeof(WEATHER_PAYLOAD);
+    packet.service_data.resize(1 + len + COUNTER_SIZE + MIC_SIZE);
+    packet.service_data[0] = BTHOME_DEVICE_INFO_ENCRYPTED;
+    uint8_t mic[MIC_SIZE];
+    int out_len;
+    EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+    check(EVP_EncryptInit_ex(ctx, EVP_aes_128_ccm(), nullptr, nullptr, nullptr));
+    check(EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_IVLEN, NONCE_SIZE, nullptr));
+    check(EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_TAG, MIC_SIZE, nullptr));
+    check(EVP_EncryptInit_ex(ctx, nullptr, nullptr, packet.key.data(), packet.nonce));
+    check(EVP_EncryptUpdate(ctx, nullptr, &out_len, nullptr, len));
+    check(EVP_EncryptUpdate(ctx, packet.service_data.data() + 1, &out_len, WEATHER_PAYLOAD, len));
+    check(EVP_EncryptFinal_ex(ctx, packet.service_data.data() + 1 + len, &out_len));
+    check(EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_GET_TAG, MIC_SIZE, mic));
+    EVP_CIPHER_CTX_free(ctx);
+    write_encrypted_trailer(packet.service_data.data() + 1 + len, COUNTER_SIZE + MIC_SIZE, uint32_t(i), mic);
+    split_encrypted_frame(packet.service_data.data(), packet.service_data.size(), packet.frame);
+
+    // Cached context: key expanded once, as in BTHomeDevice::set_encryption_key()
+    packet.cached_ctx = EVP_CIPHER_CTX_new();
+    check(EVP_DecryptInit_ex(packet.cached_ctx, EVP_aes_128_ccm(), nullptr, nullptr, nullptr));
+    check(EVP_CIPHER_CTX_ctrl(packet.cached_ctx, EVP_CTRL_AEAD_SET_IVLEN, NONCE_SIZE, nullptr));
+    check(EVP_CIPHER_CTX_ctrl(packet.cached_ctx, EVP_CTRL_AEAD_SET_TAG, MIC_SIZE, nullptr));
+    check(EVP_DecryptInit_ex(packet.cached_ctx, nullptr, nullptr, packet.key.data(), nullptr));
+  }
+  return packets;
+}
+
+void free_packets(std::vector<Packet> &packets) {
+  for (Packet &packet : packets) {
+    EVP_CIPHER_CTX_free(packet.cached_ctx);
+  }
+}
+
+// Nonce, tag and auth-decrypt on a context that already holds the expanded key (the MIC length
+// has to be set before the key, it is fixed when the key is set up)
+bool auth_decrypt(EVP_CIPHER_CTX *ctx, const Packet &packet, uint8_t *plaintext) {
+  int out_len;
+  const EncryptedFrame &frame = packet.frame;
+  check(EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_TAG, MIC_SIZE, const_cast<uint8_t *>(frame.mic)));
+  check(EVP_DecryptInit_ex(ctx, nullptr, nullptr, nullptr, packet.nonce));
+  check(EVP_DecryptUpdate(ctx, nullptr, &out_len, nullptr, frame.ciphertext_len));
+  return EVP_DecryptUpdate(ctx, plaintext, &out_len, frame.ciphertext, frame.ciphertext_len) > 0;
+}
+
+}  // namespace
+
+static void BM_DecryptPerPacketKey(benchmark::State &state) {
+  std::vector<Packet> packets = make_packets(state.range(0));
+  uint8_t plaintext[sizeof(WEATHER_PAYLOAD)];
+  size_t i = 0;
+  for (auto _ : state) {
+    const Packet &packet = packets[i++ % packets.size()];
+    // init, setkey, decrypt, free for every packet, as decrypt_payload_() used to
+    EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+    check(EVP_DecryptInit_ex(ctx, EVP_aes_128_ccm(), nullptr, nullptr, nullptr));
+    check(EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_IVLEN, NONCE_SIZE, nullptr));
+    check(EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_TAG, MIC_SIZE, nullptr));
+    check(EVP_DecryptInit_ex(ctx, nullptr, nullptr, packet.key.data(), nullptr));
+    check(auth_decrypt(ctx, packet, plaintext));
+    EVP_CIPHER_CTX_free(ctx);
+    benchmark::DoNotOptimize(plaintext);
+  }
+  state.SetItemsProcessed(state.iterations());
+  free_packets(packets);
+}
+BENCHMARK(BM_DecryptPerPacketKey)->Arg(1)->Arg(16)->Arg(128);
+
+static void BM_DecryptCachedContext(benchmark::State &state) {
+  std::vector<Packet> packets = make_packets(state.range(0));
+  uint8_t plaintext[sizeof(WEATHER_PAYLOAD)];
+  size_t i = 0;
+  for (auto _ : state) {
+    const Packet &packet = packets[i++ % packets.size()];
+    check(auth_decrypt(packet.cached_ctx, packet, plaintext));
+    benchmark::DoNotOptimize(plaintext);
+  }
+  state.SetItemsProcessed(state.iterations());
+  free_packets(packets);
+}
+BENCHMARK(BM_DecryptCachedContext)->Arg(1)->Arg(16)->Arg(128);
@@ -0,0 +1,124 @@
+// Object type lookup: the flat constexpr table in bthome_codec against the std::map lookups it
+// replaced (OBJECT_TYPE_MAP for decoding plus OBJECT_ID_NAMES for the advertisement dump).
+// Each iteration frames one recorded payload, looking up the type of every object.
+
+#include "bthome_codec.h"
+#include "payloads.h"
+
+#include <benchmark/benchmark.h>
+
+#include <map>
+#include <string>
+
+using namespace esphome::bthome_codec;
+using bthome_bench::PAYLOADS;
+
+// The former heap-allocated maps, rebuilt from the table so both sides describe the same types
+static const std::map<uint8_t, ObjectTypeInfo> &object_type_map() {
+  static const std::map<uint8_t, ObjectTypeInfo> map = [] {
+    std::map<uint8_t, ObjectTypeInfo> result;
+    for (int id = 0; id < 256; id++) {
+      const ObjectTypeInfo &info = get_object_type(id);
+      if (info.kind != ObjectKind::UNKNOWN) {
+        result.emplace(id, info);
+      }
+    }
+    return result;
+  }();
+  return map;
+}
+
+static const std::map<uint8_t, std::string> &object_id_names() {
+  static const std::map<uint8_t, std::string> map = [] {
+    std::map<uint8_t, std::string> result;
+    for (const auto &entry : object_type_map()) {
+      result.emplace(entry.first, entry.second.name);
+    }
+    return result;
+  }();
+  return map;
+}
+
+// Walk a payload using lookup(object_id) for the object sizes; returns a checksum of the factors
+template<typename Lookup> static float walk(const uint8_t *data, size_t len, Lookup lookup) {
+  float sum = 0;
+  size_t pos = 0;
+  while (pos < len) {
+    const ObjectTypeInfo *info = lookup(data[pos++]);
+    if (info == nullptr) {
+      break;
+    }
+    size_t value_len = info->data_bytes;
+    if (info->kind == ObjectKind::TEXT || info->kind == ObjectKind::RAW) {
+      value_len = pos < len ? 1 + data[pos] : len;
+    }
+    sum += info->factor;
+    pos += value_len;
+  }
+  return sum;
+}
+
+static void BM_TypeLookupMap(benchmark::State &state) {
+  const auto &payload = PAYLOADS[state.range(0)];
+  const auto &map = object_type_map();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(walk(payload.data, payload.len, [&map](uint8_t id) -> const ObjectTypeInfo * {
+      auto it = map.find(id);
+      return it != map.end() ? &it->second : nullptr;
+    }));
+  }
+  state.SetLabel(payload.name);
+}
+BENCHMARK(BM_TypeLookupMap)->DenseRange(0, 2);
+
+static void BM_TypeLookupTable(benchmark::State &state) {
+  const auto &payload = PAYLOADS[state.range(0)];
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(walk(payload.data, payload.len, [](uint8_t id) -> const ObjectTypeInfo * {
+      const ObjectTypeInfo &info = get_object_type(id);
+      return info.kind != ObjectKind::UNKNOWN ? &info : nullptr;
+    }));
+  }
+  state.SetLabel(payload.name);
+}
+BENCHMARK(BM_TypeLookupTable)->DenseRange(0, 2);
+
+// Advertisement dump: type plus name for every object
+static void BM_DumpLookupMap(benchmark::State &state) {
+  const auto &payload = PAYLOADS[state.range(0)];
+  const auto &types = object_type_map();
+  const auto &names = object_id_names();
+  for (auto _ : state) {
+    size_t name_bytes = 0;
+    benchmark::DoNotOptimize(walk(payload.data, payload.len, [&](uint8_t id) -> const ObjectTypeInfo * {
+      auto it = types.find(id);
+      if (it == types.end()) {
+        return nullptr;
+      }
+      auto name = names.find(id);
+      name_bytes += name != names.end() ? name->second.size() : 1;
+      return &it->second;
+    }));
+    benchmark::DoNotOptimize(name_bytes);
+  }
+  state.SetLabel(payload.name);
+}
+BENCHMARK(BM_DumpLookupMap)->DenseRange(0, 2);
+
+static void BM_DumpLookupTable(benchmark::State &state) {
+  const auto &payload = PAYLOADS[state.range(0)];
+  for (auto _ : state) {
+    const char *last_name = nullptr;
+    benchmark::DoNotOptimize(walk(payload.data, payload.len, [&](uint8_t id) -> const ObjectTypeInfo * {
+      const ObjectTypeInfo &info = get_object_type(id);
+      if (info.kind == ObjectKind::UNKNOWN) {
+        return nullptr;
+      }
+      last_name = object_type_name(info);
+      return &info;
+    }));
+    benchmark::DoNotOptimize(last_name);
+  }
+  state.SetLabel(payload.name);
+}
+BENCHMARK(BM_DumpLookupTable)->DenseRange(0, 2);
@@ -0,0 +1,103 @@
+// Skip-decode fast path: parse_measurements_() checks the device's 256-bit subscription bitmap and
+// skips objects no entity subscribed to. Compared with decoding every object and searching the
+// dispatch table, as before, on the weather station payload from weather_display_t5_47.yaml.
+
+#include "bthome_codec.h"
+#include "payloads.h"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace esphome::bthome_codec;
+using bthome_bench::WEATHER_PAYLOAD;
+
+namespace {
+
+// Dispatch keys and bitmap as BTHomeDevice builds them in add_dispatch_entry_()
+struct Subscriptions {
+  std::vector<uint16_t> keys;  // (object_id << 8) | index, sorted
+  std::array<uint32_t, 8> bitmap{};
+
+  Subscriptions(std::initializer_list<std::pair<uint8_t, uint8_t>> entries) {
+    for (const auto &entry : entries) {
+      this->keys.push_back(uint16_t(entry.first << 8 | entry.second));
+      this->bitmap[entry.first >> 5] |= 1u << (entry.first & 0x1F);
+    }
+    std::sort(this->keys.begin(), this->keys.end());
+  }
+
+  bool is_subscribed(uint8_t object_id) const {
+    return (this->bitmap[object_id >> 5] & (1u << (object_id & 0x1F))) != 0;
+  }
+};
+
+// The sensors of weather_display_t5_47.yaml
+const Subscriptions WEATHER_DISPLAY = {{0x45, 0}, {0x2E, 0}, {0x5F, 0}, {0x44, 0}, {0x44, 1},
+                                       {0x5E, 0}, {0x05, 0}, {0x01, 0}, {0x04, 0}, {0x08, 0}};
+// A display that only shows the outdoor temperature and humidity from the same station
+const Subscriptions TEMPERATURE_ONLY = {{0x45, 0}, {0x2E, 0}};
+const Subscriptions *const SUBSCRIPTIONS[] = {&WEATHER_DISPLAY, &TEMPERATURE_ONLY};
+const char *const SUBSCRIPTION_NAMES[] = {"weather display", "temperature only"};
+
+// Decode an object and search the dispatch table for it; returns the number of subscribers
+size_t decode_and_dispatch(const Subscriptions &subscriptions, const Object &object, float &sum) {
+  if (object.type->kind == ObjectKind::TEXT || object.type->kind == ObjectKind::RAW) {
+    // Text and raw built their string and hex dump before looking for a subscriber
+    std::string text(reinterpret_cast<const char *>(object.data), object.data_len);
+    char hex[3 * 255 + 1];
+    for (size_t i = 0; i < object.data_len; i++) {
+      std::snprintf(hex + 3 * i, 4, "%02X ", object.data[i]);
+    }
+    benchmark::DoNotOptimize(text);
+    benchmark::DoNotOptimize(hex);
+  } else {
+    sum += decode_value(*object.type, object.data);
+  }
+  uint16_t key = uint16_t(object.object_id << 8 | object.index);
+  auto range = std::equal_range(subscriptions.keys.begin(), subscriptions.keys.end(), key);
+  return range.second - range.first;
+}
+
+}  // namespace
+
+static void BM_ParseDecodeAll(benchmark::State &state) {
+  const Subscriptions &subscriptions = *SUBSCRIPTIONS[state.range(0)];
+  for (auto _ : state) {
+    ObjectReader reader(WEATHER_PAYLOAD, sizeof(WEATHER_PAYLOAD));
+    Object object;
+    float sum = 0;
+    size_t dispatched = 0;
+    while (reader.next(object) == ReadResult::OK) {
+      dispatched += decode_and_dispatch(subscriptions, object, sum);
+    }
+    benchmark::DoNotOptimize(sum);
+    benchmark::DoNotOptimize(dispatched);
+  }
+  state.SetLabel(SUBSCRIPTION_NAMES[state.range(0)]);
+}
+BENCHMARK(BM_ParseDecodeAll)->DenseRange(0, 1);
+
+static void BM_ParseSkipUnsubscribed(benchmark::State &state) {
+  const Subscriptions &subscriptions = *SUBSCRIPTIONS[state.range(0)];
+  for (auto _ : state) {
+    ObjectReader reader(WEATHER_PAYLOAD, sizeof(WEATHER_PAYLOAD));
+    Object object;
+    float sum = 0;
+    size_t dispatched = 0;
+    while (reader.next(object) == ReadResult::OK) {
+      if (!subscriptions.is_subscribed(object.object_id)) {
+        continue;
+      }
+      dispatched += decode_and_dispatch(subscriptions, object, sum);
+    }
+    benchmark::DoNotOptimize(sum);
+    benchmark::DoNotOptimize(dispatched);
+  }
+  state.SetLabel(SUBSCRIPTION_NAMES[state.range(0)]);
+}
+BENCHMARK(BM_ParseSkipUnsubscribed)->DenseRange(0, 1);
@@ -0,0 +1,36 @@
+#pragma once
+
+// Recorded BTHome v2 plaintext payloads (after device_info) used by the benchmarks
+
+#include <cstddef>
+#include <cstdint>
+
+namespace bthome_bench {
+
+// Weather station as in weather_display_t5_47.yaml: packet_id, battery, temperature_01, humidity_uint8,
+// pressure, illuminance, dewpoint, speed, gust, direction, precipitation, uv_index, firmware text
+static const uint8_t WEATHER_PAYLOAD[] = {0x00, 0x07, 0x01, 0x5D, 0x45, 0xD6, 0x00, 0x2E, 0x41, 0x04, 0x13,
+                                          0x8A, 0x01, 0x05, 0x40, 0x0D, 0x00, 0x08, 0x3C, 0x03, 0x44, 0x10,
+                                          0x01, 0x44, 0x90, 0x01, 0x5E, 0x28, 0x23, 0x5F, 0x0C, 0x00, 0x46,
+                                          0x32, 0x53, 0x06, 'v',  '1',  '.',  '4',  '.',  '2'};
+
+// Thermometer: packet_id, battery, temperature, humidity, voltage
+static const uint8_t THERMOMETER_PAYLOAD[] = {0x00, 0x2A, 0x01, 0x61, 0x02, 0xCA, 0x09,
+                                              0x03, 0xBF, 0x13, 0x0C, 0x02, 0x0C};
+
+// Two-gang switch: packet_id, two button events
+static const uint8_t BUTTON_PAYLOAD[] = {0x00, 0x11, 0x3A, 0x01, 0x3A, 0x02};
+
+struct Payload {
+  const char *name;
+  const uint8_t *data;
+  size_t len;
+};
+
+static const Payload PAYLOADS[] = {
+    {"weather", WEATHER_PAYLOAD, sizeof(WEATHER_PAYLOAD)},
+    {"thermometer", THERMOMETER_PAYLOAD, sizeof(THERMOMETER_PAYLOAD)},
+    {"button", BUTTON_PAYLOAD, sizeof(BUTTON_PAYLOAD)},
+};
+
+}  // namespace bthome_bench
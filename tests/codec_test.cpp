@@ -0,0 +1,182 @@
+// Unit tests for the platform-free BTHome v2 codec (components/bthome_codec)
+
+#include "bthome_codec.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+using namespace esphome::bthome_codec;
+
+static int failures = 0;
+
+#define CHECK(cond) \
+  do { \
+    if (!(cond)) { \
+      std::printf("%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+      failures++; \
+    } \
+  } while (0)
+
+static void test_object_type_table() {
+  const ObjectTypeInfo &temperature = get_object_type(0x02);
+  CHECK(temperature.kind == ObjectKind::SENSOR);
+  CHECK(temperature.data_bytes == 2);
+  CHECK(temperature.is_signed);
+  CHECK(std::strcmp(object_type_name(temperature), "temperature") == 0);
+
+  CHECK(get_object_type(0x1A).kind == ObjectKind::BINARY_SENSOR);
+  CHECK(get_object_type(OBJECT_ID_BUTTON).kind == ObjectKind::BUTTON);
+  CHECK(get_object_type(OBJECT_ID_DIMMER).kind == ObjectKind::DIMMER);
+  CHECK(get_object_type(OBJECT_ID_TEXT).kind == ObjectKind::TEXT);
+  CHECK(get_object_type(OBJECT_ID_RAW).kind == ObjectKind::RAW);
+
+  const ObjectTypeInfo &undefined = get_object_type(0xFF);
+  CHECK(undefined.kind == ObjectKind::UNKNOWN);
+  CHECK(undefined.name == nullptr);
+  CHECK(std::strcmp(object_type_name(undefined), "?") == 0);
+}
+
+static void test_encode_value() {
+  uint8_t out[8];
+  // 21.5 degC at 0.01 resolution = 2150 = 0x0866
+  CHECK(encode_value(out, sizeof(out), 0x02, 2, true, 0.01f, 21.5f) == 3);
+  CHECK(out[0] == 0x02 && out[1] == 0x66 && out[2] == 0x08);
+  CHECK(encode_value(out, sizeof(out), 0x02, 2, true, 0.01f, -1.0f) == 3);
+  CHECK(out[1] == 0x9C && out[2] == 0xFF);
+
+  // Out of range values clamp instead of wrapping
+  CHECK(encode_value(out, sizeof(out), 0x02, 2, true, 0.01f, 1000.0f) == 3);
+  CHECK(out[1] == 0xFF && out[2] == 0x7F);
+  CHECK(encode_value(out, sizeof(out), 0x01, 1, false, 1.0f, -5.0f) == 2);
+  CHECK(out[1] == 0x00);
+  CHECK(encode_value(out, sizeof(out), 0x3E, 4, false, 1.0f, 1e12f) == 5);
+  CHECK(out[1] == 0xFF && out[2] == 0xFF && out[3] == 0xFF && out[4] == 0xFF);
+
+  // Does not fit, or invalid size
+  CHECK(encode_value(out, 2, 0x02, 2, true, 0.01f, 21.5f) == 0);
+  CHECK(encode_value(out, sizeof(out), 0x02, 0, true, 0.01f, 21.5f) == 0);
+  CHECK(encode_value(out, sizeof(out), 0x02, 5, true, 0.01f, 21.5f) == 0);
+
+  CHECK(encode_binary(out, sizeof(out), 0x1A, true) == 2);
+  CHECK(out[0] == 0x1A && out[1] == 0x01);
+  CHECK(encode_binary(out, 1, 0x1A, true) == 0);
+
+  const uint8_t event[] = {BUTTON_EVENT_DOUBLE_PRESS};
+  CHECK(encode_event(out, sizeof(out), OBJECT_ID_BUTTON, event, sizeof(event)) == 2);
+  CHECK(out[0] == OBJECT_ID_BUTTON && out[1] == BUTTON_EVENT_DOUBLE_PRESS);
+  CHECK(encode_event(out, 1, OBJECT_ID_BUTTON, event, sizeof(event)) == 0);
+}
+
+static void test_decode_value() {
+  const uint8_t negative[] = {0x9C, 0xFF};
+  CHECK(decode_raw_value(get_object_type(0x02), negative) == -100);
+  CHECK(std::fabs(decode_value(get_object_type(0x02), negative) + 1.0f) < 1e-6f);
+
+  // 3-byte signed values sign-extend from bit 23, unsigned ones do not
+  const uint8_t three[] = {0xFF, 0xFF, 0xFF};
+  const ObjectTypeInfo signed24{"test", 1.0f, 3, true, ObjectKind::SENSOR};
+  CHECK(decode_raw_value(signed24, three) == -1);
+  CHECK(decode_raw_value(get_object_type(0x04), three) == 0xFFFFFF);
+
+  const uint8_t four[] = {0x01, 0x00, 0x00, 0x80};
+  CHECK(decode_raw_value(get_object_type(0x5B), four) == INT32_MIN + 1);
+}
+
+static void test_object_reader() {
+  // packet_id, temperature, speed, speed (gust), text "hi", door
+  const uint8_t payload[] = {0x00, 0x07, 0x02, 0x66, 0x08, 0x44, 0x10, 0x00, 0x44,
+                             0x20, 0x00, 0x53, 0x02, 'h',  'i',  0x1A, 0x01};
+  ObjectReader reader(payload, sizeof(payload));
+  Object object;
+
+  CHECK(reader.next(object) == ReadResult::OK);
+  CHECK(object.object_id == 0x00 && object.data_len == 1 && object.data[0] == 0x07);
+  CHECK(reader.next(object) == ReadResult::OK);
+  CHECK(object.object_id == 0x02 && object.offset == 2);
+  CHECK(decode_raw_value(*object.type, object.data) == 2150);
+  CHECK(reader.next(object) == ReadResult::OK);
+  CHECK(object.object_id == 0x44 && object.index == 0);
+  CHECK(reader.next(object) == ReadResult::OK);
+  CHECK(object.object_id == 0x44 && object.index == 1 && object.data[0] == 0x20);
+  CHECK(reader.next(object) == ReadResult::OK);
+  CHECK(object.object_id == OBJECT_ID_TEXT && object.data_len == 2 && object.data[0] == 'h');
+  CHECK(reader.next(object) == ReadResult::OK);
+  CHECK(object.object_id == 0x1A && object.data[0] == 0x01);
+  CHECK(reader.next(object) == ReadResult::END);
+  CHECK(reader.position() == sizeof(payload));
+
+  // Value cut off
+  const uint8_t truncated[] = {0x02, 0x66};
+  ObjectReader truncated_reader(truncated, sizeof(truncated));
+  CHECK(truncated_reader.next(object) == ReadResult::TRUNCATED);
+
+  // Length prefix missing, and length past the end
+  const uint8_t no_length[] = {0x53};
+  ObjectReader no_length_reader(no_length, sizeof(no_length));
+  CHECK(no_length_reader.next(object) == ReadResult::TRUNCATED);
+  const uint8_t long_text[] = {0x53, 0x05, 'a'};
+  ObjectReader long_text_reader(long_text, sizeof(long_text));
+  CHECK(long_text_reader.next(object) == ReadResult::TRUNCATED);
+
+  // Undefined object ID stops reading
+  const uint8_t unknown[] = {0x01, 0x64, 0xFE, 0x00};
+  ObjectReader unknown_reader(unknown, sizeof(unknown));
+  CHECK(unknown_reader.next(object) == ReadResult::OK);
+  CHECK(unknown_reader.next(object) == ReadResult::UNKNOWN_OBJECT);
+  CHECK(object.object_id == 0xFE);
+
+  ObjectReader empty_reader(payload, 0);
+  CHECK(empty_reader.next(object) == ReadResult::END);
+}
+
+static void test_nonce() {
+  uint8_t mac[6];
+  mac_to_bytes(0x5448E68F80A5ULL, mac);
+  const uint8_t expected_mac[] = {0x54, 0x48, 0xE6, 0x8F, 0x80, 0xA5};
+  CHECK(std::memcmp(mac, expected_mac, sizeof(mac)) == 0);
+
+  // MAC as written, UUID little-endian, device info, counter little-endian
+  uint8_t nonce[NONCE_SIZE];
+  build_nonce(nonce, mac, BTHOME_DEVICE_INFO_ENCRYPTED, 0x00112233);
+  const uint8_t expected_nonce[] = {0x54, 0x48, 0xE6, 0x8F, 0x80, 0xA5, 0xD2,
+                                    0xFC, 0x41, 0x33, 0x22, 0x11, 0x00};
+  CHECK(std::memcmp(nonce, expected_nonce, sizeof(nonce)) == 0);
+}
+
+static void test_encrypted_frame() {
+  // device_info + ciphertext(3) + counter + MIC
+  uint8_t service_data[1 + 3 + COUNTER_SIZE + MIC_SIZE] = {BTHOME_DEVICE_INFO_ENCRYPTED, 0xA1, 0xA2, 0xA3};
+  const uint8_t mic[] = {0xB1, 0xB2, 0xB3, 0xB4};
+  CHECK(write_encrypted_trailer(service_data + 4, COUNTER_SIZE + MIC_SIZE - 1, 0x01020304, mic) == 0);
+  CHECK(write_encrypted_trailer(service_data + 4, COUNTER_SIZE + MIC_SIZE, 0x01020304, mic) == 8);
+  CHECK(service_data[4] == 0x04 && service_data[7] == 0x01 && service_data[8] == 0xB1);
+
+  EncryptedFrame frame;
+  CHECK(split_encrypted_frame(service_data, sizeof(service_data), frame));
+  CHECK(frame.device_info == BTHOME_DEVICE_INFO_ENCRYPTED);
+  CHECK(frame.ciphertext == service_data + 1 && frame.ciphertext_len == 3);
+  CHECK(frame.counter == 0x01020304);
+  CHECK(frame.mic == service_data + 8);
+  CHECK(read_encrypted_counter(service_data, sizeof(service_data)) == 0x01020304);
+
+  // Empty ciphertext is still a valid frame, one byte less is not
+  CHECK(split_encrypted_frame(service_data + 3, 1 + COUNTER_SIZE + MIC_SIZE, frame));
+  CHECK(frame.ciphertext_len == 0);
+  CHECK(!split_encrypted_frame(service_data, COUNTER_SIZE + MIC_SIZE, frame));
+}
+
+int main() {
+  test_object_type_table();
+  test_encode_value();
+  test_decode_value();
+  test_object_reader();
+  test_nonce();
+  test_encrypted_frame();
+  if (failures > 0) {
+    std::printf("%d check(s) failed\n", failures);
+    return 1;
+  }
+  std::printf("All codec tests passed\n");
+  return 0;
+}
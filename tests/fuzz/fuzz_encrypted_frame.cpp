@@ -0,0 +1,44 @@
+// Fuzz target: split_encrypted_frame, write_encrypted_trailer and build_nonce over arbitrary
+// service data. A frame that splits must lie inside the input and rebuild to the same bytes.
+
+#include "bthome_codec.h"
+
+#include <cstdlib>
+#include <cstring>
+
+using namespace esphome::bthome_codec;
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  EncryptedFrame frame;
+  if (!split_encrypted_frame(data, size, frame)) {
+    if (size >= 1 + COUNTER_SIZE + MIC_SIZE) {
+      std::abort();
+    }
+    return 0;
+  }
+  if (frame.ciphertext != data + 1 || 1 + frame.ciphertext_len + COUNTER_SIZE + MIC_SIZE != size ||
+      frame.mic + MIC_SIZE != data + size || frame.counter != read_encrypted_counter(data, size)) {
+    std::abort();
+  }
+
+  uint8_t trailer[COUNTER_SIZE + MIC_SIZE];
+  if (write_encrypted_trailer(trailer, sizeof(trailer), frame.counter, frame.mic) != sizeof(trailer) ||
+      std::memcmp(trailer, data + size - sizeof(trailer), sizeof(trailer)) != 0) {
+    std::abort();
+  }
+
+  // The receiver takes the MAC from its 48-bit address; use the first input bytes as one
+  uint64_t address = 0;
+  for (size_t i = 0; i < 6 && i < size; i++) {
+    address = (address << 8) | data[i];
+  }
+  uint8_t mac[6];
+  uint8_t nonce[NONCE_SIZE];
+  mac_to_bytes(address, mac);
+  build_nonce(nonce, mac, frame.device_info, frame.counter);
+  if (std::memcmp(nonce, mac, sizeof(mac)) != 0 || nonce[8] != frame.device_info ||
+      std::memcmp(nonce + 9, data + size - sizeof(trailer), COUNTER_SIZE) != 0) {
+    std::abort();
+  }
+  return 0;
+}
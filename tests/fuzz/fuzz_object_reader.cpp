@@ -0,0 +1,45 @@
+// Fuzz target: ObjectReader over arbitrary plaintext payloads.
+// Every object it returns must lie inside the input, and SENSOR values must re-encode to the
+// bytes they were decoded from.
+
+#include "bthome_codec.h"
+
+#include <cstdlib>
+#include <cstring>
+
+using namespace esphome::bthome_codec;
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  ObjectReader reader(data, size);
+  Object object;
+  size_t last_position = 0;
+
+  while (true) {
+    ReadResult result = reader.next(object);
+    if (result != ReadResult::OK) {
+      if (result == ReadResult::END && reader.position() != size) {
+        std::abort();
+      }
+      break;
+    }
+    if (object.offset >= size || object.data < data || object.data + object.data_len > data + size ||
+        reader.position() <= last_position) {
+      std::abort();
+    }
+    last_position = reader.position();
+
+    if (object.type->kind == ObjectKind::SENSOR) {
+      int32_t raw = decode_raw_value(*object.type, object.data);
+      double value = object.type->is_signed ? double(raw) : double(uint32_t(raw));
+      uint8_t encoded[5];
+      size_t len = encode_value(encoded, sizeof(encoded), object.object_id, object.type->data_bytes,
+                                object.type->is_signed, 1.0f, float(value));
+      // float holds 24 bits exactly, wider values are not expected to round-trip
+      if (object.type->data_bytes <= 3 &&
+          (len != 1u + object.data_len || std::memcmp(encoded + 1, object.data, object.data_len) != 0)) {
+        std::abort();
+      }
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,149 @@
+// Advertisement scheduling of the bthome sender (bthome_codec::build_schedule) for every
+// advertisement size from 0 to 255 bytes, plain and encrypted. Each frame is also encoded into an
+// exactly sized buffer the way BTHome::build_advertisement_data_() lays it out, and read back.
+
+#include "bthome_codec.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+using namespace esphome::bthome_codec;
+
+static int failures = 0;
+
+#define CHECK(cond) \
+  do { \
+    if (!(cond)) { \
+      std::printf("%s:%d: CHECK failed: %s (max_len %zu, %s, %s)\n", __FILE__, __LINE__, #cond, max_len, \
+                  encrypted ? "encrypted" : "plain", config.name); \
+      failures++; \
+      return; \
+    } \
+  } while (0)
+
+struct Config {
+  const char *name;
+  std::vector<ScheduleItem> items;
+};
+
+// Object ID for an item of the given encoded size: battery, temperature, pressure, count_uint32
+static uint8_t object_id_for(const ScheduleItem &item) {
+  if (item.id & SCHEDULE_BINARY) {
+    return 0x1A;
+  }
+  static const uint8_t IDS[] = {0x01, 0x02, 0x04, 0x3E};
+  return IDS[item.size - 2];
+}
+
+static std::vector<ScheduleItem> make_config(size_t sensors, size_t binary_sensors, uint16_t period_every) {
+  std::vector<ScheduleItem> items;
+  for (size_t i = 0; i < sensors; i++) {
+    uint16_t period = period_every > 0 && i % period_every == 0 ? 2 : 0;
+    items.push_back({(uint16_t) i, (uint8_t) (2 + i % 4), period});
+  }
+  for (size_t i = 0; i < binary_sensors; i++) {
+    items.push_back({(uint16_t) (i | SCHEDULE_BINARY), 2, 0});
+  }
+  return items;
+}
+
+static void check_schedule(const Config &config, size_t max_len, bool encrypted) {
+  const size_t capacity = payload_capacity(max_len, encrypted);
+  const size_t overhead = ADV_HEADER_SIZE + (encrypted ? ENCRYPTION_OVERHEAD : 0);
+  CHECK(capacity == (max_len > overhead ? max_len - overhead : 0));
+
+  // As BTHOME_MAX_ADV_PACKETS: one frame per measurement
+  const size_t max_frames = std::max<size_t>(1, config.items.size());
+  std::vector<std::vector<uint16_t>> frames;
+  ScheduleResult result = build_schedule(config.items, capacity, max_frames, frames);
+
+  bool too_large = std::any_of(config.items.begin(), config.items.end(),
+                               [capacity](const ScheduleItem &item) { return item.size > capacity; });
+  if (too_large) {
+    CHECK(result == ScheduleResult::ITEM_TOO_LARGE);
+    CHECK(frames.size() == 1 && frames[0].empty());
+    return;
+  }
+  CHECK(result != ScheduleResult::ITEM_TOO_LARGE);
+  CHECK(!frames.empty() && frames.size() <= max_frames);
+
+  for (const ScheduleItem &item : config.items) {
+    // Frames in which the item appears
+    std::vector<size_t> appearances;
+    for (size_t f = 0; f < frames.size(); f++) {
+      if (std::count(frames[f].begin(), frames[f].end(), item.id) > 0) {
+        appearances.push_back(f);
+      }
+    }
+    CHECK(!appearances.empty());
+    if (result == ScheduleResult::OK && item.period > 0) {
+      // Largest gap between two appearances, wrapping around the rotation
+      size_t gap = appearances.front() + frames.size() - appearances.back();
+      for (size_t i = 1; i < appearances.size(); i++) {
+        gap = std::max(gap, appearances[i] - appearances[i - 1]);
+      }
+      CHECK(gap <= item.period);
+    }
+  }
+
+  for (const auto &frame : frames) {
+    CHECK(std::is_sorted(frame.begin(), frame.end()));
+    CHECK(std::adjacent_find(frame.begin(), frame.end()) == frame.end());
+    if (max_len < overhead) {
+      // No room for the header: only an empty schedule gets here, and there is nothing to send
+      CHECK(frame.empty());
+      continue;
+    }
+
+    // Header: flags, service data length, type, UUID, device info, packet ID
+    std::vector<uint8_t> adv(max_len);
+    size_t pos = ADV_HEADER_SIZE;
+    const size_t payload_end = max_len - (encrypted ? ENCRYPTION_OVERHEAD : 0);
+    size_t objects = 0;
+    for (uint16_t id : frame) {
+      const ScheduleItem &item = *std::find_if(config.items.begin(), config.items.end(),
+                                               [id](const ScheduleItem &i) { return i.id == id; });
+      size_t len = (id & SCHEDULE_BINARY)
+                       ? encode_binary(adv.data() + pos, payload_end - pos, object_id_for(item), true)
+                       : encode_value(adv.data() + pos, payload_end - pos, object_id_for(item), item.size - 1, false,
+                                      1.0f, 1.0f);
+      CHECK(len == item.size);
+      pos += len;
+      objects++;
+    }
+    if (encrypted) {
+      const uint8_t mic[MIC_SIZE] = {};
+      CHECK(write_encrypted_trailer(adv.data() + pos, max_len - pos, 1, mic) == ENCRYPTION_OVERHEAD);
+    }
+
+    ObjectReader reader(adv.data() + ADV_HEADER_SIZE, pos - ADV_HEADER_SIZE);
+    Object object;
+    size_t read = 0;
+    while (reader.next(object) == ReadResult::OK) {
+      read++;
+    }
+    CHECK(read == objects && reader.position() == pos - ADV_HEADER_SIZE);
+  }
+}
+
+int main() {
+  const Config configs[] = {
+      {"empty", {}},
+      {"thermometer", make_config(4, 0, 0)},
+      {"weather station", make_config(10, 2, 0)},
+      {"large with max_staleness", make_config(40, 8, 5)},
+  };
+  for (const Config &config : configs) {
+    for (size_t max_len = 0; max_len <= 255; max_len++) {
+      check_schedule(config, max_len, false);
+      check_schedule(config, max_len, true);
+    }
+  }
+  if (failures > 0) {
+    std::printf("%d check(s) failed\n", failures);
+    return 1;
+  }
+  std::printf("All schedule tests passed\n");
+  return 0;
+}
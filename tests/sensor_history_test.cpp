@@ -0,0 +1,223 @@
+// Sensor history of the receiver (components/bthome_receiver/sensor_history) against a
+// brute-force reference: a plain list of samples with the same window and slot budget, whose
+// aggregates are recomputed from scratch after every step.
+
+#include "sensor_history.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <deque>
+#include <random>
+
+using esphome::bthome_receiver::SensorHistory;
+
+static int failures = 0;
+
+#define CHECK(cond) \
+  do { \
+    if (!(cond)) { \
+      std::printf("%s:%d: CHECK failed: %s (%s, step %d)\n", __FILE__, __LINE__, #cond, name, step); \
+      failures++; \
+      return; \
+    } \
+  } while (0)
+
+class Reference {
+ public:
+  Reference(size_t max_samples, uint32_t window_ms, float resolution)
+      : capacity_(max_samples < 2 ? 2 : max_samples),
+        window_ms_(std::min(window_ms, SensorHistory::MAX_WINDOW_MS)),
+        resolution_(resolution) {}
+
+  void add(uint32_t now, float value) {
+    this->expire(now);
+    int64_t raw = this->quantize_(value);
+    size_t width = 1;
+    uint32_t time = now;
+    if (!this->samples_.empty()) {
+      // Times advance by whole seconds and a change outside int16 takes a second slot
+      uint32_t dt = std::min<uint32_t>((now - this->back_time_) / 1000, UINT16_MAX);
+      time = this->back_time_ + dt * 1000;
+      int64_t dv = raw - this->back_raw_;
+      width = dv <= INT16_MIN || dv > INT16_MAX ? 2 : 1;
+    }
+    while (this->slots_ + width > this->capacity_) {
+      this->pop_front_();
+    }
+    if (this->samples_.empty()) {
+      time = now;
+    }
+    this->samples_.push_back({time, raw, width});
+    this->slots_ += width;
+    this->back_time_ = time;
+    this->back_raw_ = raw;
+  }
+
+  void expire(uint32_t now) {
+    while (!this->samples_.empty() && now - this->samples_.front().time > this->window_ms_) {
+      this->pop_front_();
+    }
+  }
+
+  size_t size() const { return this->samples_.size(); }
+  double min() const {
+    int64_t m = INT64_MAX;
+    for (const Sample &s : this->samples_) {
+      m = std::min(m, s.raw);
+    }
+    return m * (double) this->resolution_;
+  }
+  double max() const {
+    int64_t m = INT64_MIN;
+    for (const Sample &s : this->samples_) {
+      m = std::max(m, s.raw);
+    }
+    return m * (double) this->resolution_;
+  }
+  double sum() const {
+    int64_t total = 0;
+    for (const Sample &s : this->samples_) {
+      total += s.raw;
+    }
+    return total * (double) this->resolution_;
+  }
+
+ protected:
+  struct Sample {
+    uint32_t time;
+    int64_t raw;
+    size_t width;
+  };
+
+  int64_t quantize_(float value) const {
+    double scaled = std::nearbyint((double) value / this->resolution_);
+    return (int64_t) std::max<double>(INT32_MIN, std::min<double>(INT32_MAX, scaled));
+  }
+
+  void pop_front_() {
+    this->slots_ -= this->samples_.front().width;
+    this->samples_.pop_front();
+  }
+
+  std::deque<Sample> samples_;
+  size_t capacity_;
+  uint32_t window_ms_;
+  float resolution_;
+  size_t slots_{0};
+  uint32_t back_time_{0};
+  int64_t back_raw_{0};
+};
+
+static bool near(double actual, double expected) {
+  return std::fabs(actual - expected) <= 1e-5 * std::max(1.0, std::fabs(expected));
+}
+
+// Quantize like the history does, so values the reference sees match bit for bit
+static float on_grid(int64_t raw, float resolution) { return (float) (raw * (double) resolution); }
+
+enum class Values {
+  SMOOTH,     // Changes fit the 16-bit delta
+  JUMPS,      // Every few samples the change overflows the delta and is escaped
+  EXTREMES,   // Values at and beyond the int32 range, clamped
+  BOUNDARY,   // Changes on either side of the int16 limits of the delta
+};
+
+struct Scenario {
+  const char *name;
+  size_t max_samples;
+  uint32_t window_ms;
+  float resolution;
+  uint32_t max_gap_ms;  // Largest time between samples
+  Values values;
+  uint32_t start;       // Time of the first sample, near UINT32_MAX to cross the millis() wrap
+};
+
+static void run(const Scenario &scenario, uint32_t seed) {
+  const char *name = scenario.name;
+  int step = -1;
+  SensorHistory history;
+  CHECK(history.init(scenario.max_samples, scenario.window_ms, scenario.resolution));
+  Reference reference(scenario.max_samples, scenario.window_ms, scenario.resolution);
+  CHECK(std::isnan(history.get_min()) && std::isnan(history.get_mean()));
+
+  std::mt19937 rng(seed);
+  uint32_t now = scenario.start;
+  int64_t raw = 0;
+  for (step = 0; step < 3000; step++) {
+    now += rng() % (scenario.max_gap_ms + 1);
+    switch (scenario.values) {
+      case Values::SMOOTH:
+        raw += (int64_t) (rng() % 2001) - 1000;
+        break;
+      case Values::JUMPS:
+        raw = rng() % 4 == 0 ? (int64_t) (rng() % 2000001) - 1000000 : raw + (int64_t) (rng() % 201) - 100;
+        break;
+      case Values::EXTREMES: {
+        static const int64_t EDGES[] = {INT32_MIN, INT32_MAX, 0, (int64_t) INT32_MAX * 2, (int64_t) INT32_MIN * 2};
+        raw = rng() % 2 == 0 ? EDGES[rng() % 5] : (int64_t) (rng() % 65536) - 32768;
+        break;
+      }
+      case Values::BOUNDARY: {
+        static const int64_t STEPS[] = {INT16_MIN - 1, INT16_MIN, INT16_MIN + 1, INT16_MAX, INT16_MAX + 1};
+        raw = std::max<int64_t>(-1000000, std::min<int64_t>(1000000, raw + STEPS[rng() % 5]));
+        break;
+      }
+    }
+    float value = on_grid(raw, scenario.resolution);
+
+    // Every tenth step only lets time pass, the way the stats interval expires a quiet device
+    if (step % 10 == 9) {
+      history.expire(now);
+      reference.expire(now);
+    } else {
+      history.add(now, value);
+      reference.add(now, value);
+    }
+
+    CHECK(history.size() == reference.size());
+    if (reference.size() == 0) {
+      CHECK(std::isnan(history.get_min()) && std::isnan(history.get_max()));
+      CHECK(std::isnan(history.get_sum()) && std::isnan(history.get_mean()));
+      continue;
+    }
+    CHECK(near(history.get_min(), reference.min()));
+    CHECK(near(history.get_max(), reference.max()));
+    CHECK(near(history.get_sum(), reference.sum()));
+    CHECK(near(history.get_mean(), reference.sum() / reference.size()));
+  }
+
+  // A gap longer than the window empties the history
+  now += std::min(scenario.window_ms, SensorHistory::MAX_WINDOW_MS) + 1000;
+  history.expire(now);
+  CHECK(history.size() == 0 && std::isnan(history.get_sum()));
+}
+
+int main() {
+  const Scenario scenarios[] = {
+      // Window shorter than the buffer: samples leave by age
+      {"expiry", 500, 60000, 0.01f, 5000, Values::SMOOTH, 1000},
+      // Buffer smaller than the window: samples leave by count and the ring wraps many times
+      {"wraparound", 7, 3600000, 0.1f, 2000, Values::SMOOTH, 1000},
+      {"escaped deltas", 16, 600000, 1.0f, 10000, Values::JUMPS, 1000},
+      // Two-slot samples in the smallest buffer, evicted by age and by count
+      {"escaped, minimum size", 1, 30000, 1.0f, 20000, Values::JUMPS, 1000},
+      {"int16 boundary", 12, 600000, 1.0f, 10000, Values::BOUNDARY, 1000},
+      {"int32 range", 9, 120000, 1.0f, 15000, Values::EXTREMES, 1000},
+      {"millis() wrap", 32, 300000, 0.01f, 30000, Values::JUMPS, UINT32_MAX - 5000000},
+      // Window beyond what 16-bit seconds cover is capped at MAX_WINDOW_MS
+      {"long window", 64, 0xFFFFFFFFu, 1.0f, 4000000, Values::JUMPS, 1000},
+  };
+  for (const Scenario &scenario : scenarios) {
+    for (uint32_t seed = 1; seed <= 5; seed++) {
+      run(scenario, seed);
+    }
+  }
+  if (failures > 0) {
+    std::printf("%d check(s) failed\n", failures);
+    return 1;
+  }
+  std::printf("All sensor history tests passed\n");
+  return 0;
+}
@@ -0,0 +1,16 @@
+// Host stand-in for the parts of ESPHome's helpers.h used by code under test
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+
+namespace esphome {
+
+// The firmware's allocator prefers PSRAM; on the host it is plain malloc
+template<class T> class RAMAllocator {
+ public:
+  T *allocate(size_t n) { return static_cast<T *>(std::malloc(n * sizeof(T))); }
+  void deallocate(T *p, size_t) { std::free(p); }
+};
+
+}  // namespace esphome